@@ -0,0 +1,40 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "huffman/codec.h"
+#include "huffman/histogram.h"
+
+// Bytes encoded from the head of the input to estimate the encoding rate
+#define ANALYSIS_CALIBRATION_SIZE (1024 * 1024)
+
+// What compressing an input would produce, from its counting pass only.
+// Sizes are exact unless the counts were sampled. Symbols are those left
+// by the filters, if any. Header and coded sizes are those of a single
+// table; when the input would be split into blocks, `compressed_size` is
+// that of the blocks instead.
+typedef struct analysis_t {
+	long unsigned int file_length;
+	bool sampled;
+	unsigned char filters;
+	unsigned int symbol_count;
+	double entropy;
+	long unsigned int coded_size;
+	long unsigned int header_size;
+	unsigned int block_count;
+	long unsigned int blocks_size;
+	long unsigned int compressed_size;
+	unsigned int max_code_length;
+	double count_time;
+	double estimated_time;
+} analysis_t;
+
+int analyze_stream(FILE *input, compression_level_t level,
+		   unsigned char filters, codec_t *codec,
+		   analysis_t *analysis);
+void analysis_print(FILE *output, const char *name,
+		    const analysis_t *analysis);
+
+#endif
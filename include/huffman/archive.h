@@ -0,0 +1,58 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "huffman/codec.h"
+#include "huffman/huffman.h"
+
+// Layout: magic, optional shared frequency table, members, central
+// directory, then a fixed-size trailer locating the directory.
+#define ARCHIVE_MAGIC "HUFA"
+#define ARCHIVE_MAGIC_SIZE 4
+#define ARCHIVE_TRAILER_SIZE \
+	(2 * sizeof(long unsigned int) + sizeof(unsigned int) + \
+	 ARCHIVE_MAGIC_SIZE)
+#define ARCHIVE_NAME_MAX 4096
+
+// Member coded with the shared table: bits only, no header
+#define ARCHIVE_MEMBER_SHARED 0x01
+
+typedef enum archive_table_t {
+	ARCHIVE_TABLE_AUTO = 0,
+	ARCHIVE_TABLE_OWN = 1,
+	ARCHIVE_TABLE_SHARED = 2
+} archive_table_t;
+
+typedef struct archive_member_t {
+	char *name;
+	long unsigned int length;
+	long unsigned int offset;
+	long unsigned int size;
+	unsigned char flags;
+} archive_member_t;
+
+typedef struct archive_t {
+	char *filename;
+	archive_member_t *members;
+	unsigned int count;
+	long unsigned int shared_offset;
+	frequency_table_t shared;
+} archive_t;
+
+int archive_table_parse(const char *name, archive_table_t *table);
+bool __archive_name_safe(const char *name);
+
+int archive_create(const char *filename, char *const *paths, int count,
+		   archive_table_t table);
+
+int archive_open(archive_t *archive, const char *filename);
+int archive_find(const archive_t *archive, const char *name);
+int archive_extract_member(archive_t *archive, FILE *file, unsigned int index,
+			   const char *directory, codec_t *codec);
+int archive_extract(archive_t *archive, const unsigned int *indices,
+		    unsigned int count, const char *directory, int threads);
+void archive_close(archive_t *archive);
+
+#endif
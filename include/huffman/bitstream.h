@@ -0,0 +1,122 @@
+#ifndef BITSTREAM_H
+#define BITSTREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "huffman/output.h"
+
+#define BITSTREAM_BUFFER_SIZE (256 * 1024)
+// Largest bit count accepted by a single put or peek
+#define BITSTREAM_MAX_BITS 56
+
+// Writers flush to an output: their own over a stream, or the caller's.
+// A failed write is kept in `failed`, and reported by the flush.
+typedef struct bit_writer_t {
+	output_t stream;
+	output_t *output;
+	uint64_t accumulator;
+	unsigned int count;
+	unsigned char *buffer;
+	size_t length;
+	size_t capacity;
+	int failed;
+} bit_writer_t;
+
+typedef struct bit_reader_t {
+	FILE *file;
+	uint64_t accumulator;
+	unsigned int count;
+	unsigned char *buffer;
+	size_t position;
+	size_t length;
+	size_t capacity;
+} bit_reader_t;
+
+int bit_writer_create(bit_writer_t *writer, FILE *file);
+int bit_writer_create_output(bit_writer_t *writer, output_t *output);
+int bit_writer_flush(bit_writer_t *writer);
+void bit_writer_destroy(bit_writer_t *writer);
+int __bit_writer_write(bit_writer_t *writer);
+
+int bit_reader_create(bit_reader_t *reader, FILE *file);
+void bit_reader_destroy(bit_reader_t *reader);
+void __bit_reader_fill(bit_reader_t *reader);
+
+static inline void __bit_writer_drain(bit_writer_t *writer)
+{
+	if (writer->capacity - writer->length < 8)
+		__bit_writer_write(writer);
+
+	// Store all eight bytes of the accumulator (big-endian) and only
+	// advance past the complete ones.
+	unsigned char *out = writer->buffer + writer->length;
+	for (int i = 0; i < 8; i++) {
+		out[i] = (unsigned char)(writer->accumulator >> (56 - 8 * i));
+	}
+
+	unsigned int bytes = writer->count >> 3;
+	writer->length += bytes;
+	writer->accumulator = 8 == bytes ? 0 :
+	    writer->accumulator << (8 * bytes);
+	writer->count -= 8 * bytes;
+}
+
+// Appends the `count` low bits of `bits`, most significant first.
+// `count` must be in [1, BITSTREAM_MAX_BITS].
+static inline void bit_writer_put(bit_writer_t *writer, uint64_t bits,
+				  unsigned int count)
+{
+	if (writer->count + count > 64)
+		__bit_writer_drain(writer);
+
+	writer->accumulator |= bits << (64 - writer->count - count);
+	writer->count += count;
+}
+
+static inline void bit_reader_refill(bit_reader_t *reader)
+{
+	if (reader->length - reader->position < 8)
+		__bit_reader_fill(reader);
+
+	const unsigned char *in = reader->buffer + reader->position;
+	uint64_t word = 0;
+	for (int i = 0; i < 8; i++) {
+		word = (word << 8) | in[i];
+	}
+
+	reader->accumulator |= word >> reader->count;
+	reader->position += (63 - reader->count) >> 3;
+	reader->count |= 56;
+}
+
+// Returns the next `count` bits without consuming them. Past the end of
+// the stream, zero bits are returned. `count` must be in
+// [1, BITSTREAM_MAX_BITS].
+static inline uint64_t bit_reader_peek(bit_reader_t *reader,
+				       unsigned int count)
+{
+	if (reader->count < count)
+		bit_reader_refill(reader);
+
+	return reader->accumulator >> (64 - count);
+}
+
+static inline void bit_reader_consume(bit_reader_t *reader,
+				      unsigned int count)
+{
+	reader->accumulator <<= count;
+	reader->count -= count;
+}
+
+static inline uint64_t bit_reader_read(bit_reader_t *reader,
+				       unsigned int count)
+{
+	uint64_t bits = bit_reader_peek(reader, count);
+	bit_reader_consume(reader, count);
+
+	return bits;
+}
+
+#endif
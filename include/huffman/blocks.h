@@ -0,0 +1,55 @@
+#ifndef BLOCKS_H
+#define BLOCKS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "huffman/codec.h"
+#include "huffman/huffman.h"
+#include "huffman/output.h"
+#include "huffman/statistics.h"
+
+// Statistics are compared chunk by chunk: blocks start on a chunk
+#define BLOCKS_CHUNK_SIZE (256 * 1024)
+// Chunk tables kept while splitting, 2 KiB each
+#define BLOCKS_MAX_CHUNKS 4096
+// Building the tables of a block, to encode then to decode it, takes
+// about half a millisecond: blocks average at least this length, so that
+// the setups stay a small share of the coding time
+#define BLOCKS_MIN_LENGTH (1024 * 1024)
+// Memory limits below which the chunk tables are not worth keeping
+#define BLOCKS_MEMORY (16 * 1024 * 1024)
+// Length and size of each block, after the stream length and count
+#define BLOCKS_ENTRY_SIZE (2 * sizeof(long unsigned int))
+
+// `size` counts the bytes of the block's table and codes
+typedef struct block_t {
+	long unsigned int length;
+	long unsigned int size;
+	frequency_t table[HUFFMAN_MAX_SYMBOLS];
+} block_t;
+
+// `size` counts the bytes of the whole stream, header included
+typedef struct blocks_t {
+	block_t *blocks;
+	unsigned int count;
+	long unsigned int size;
+} blocks_t;
+
+bool blocks_eligible(FILE *input, long length);
+long unsigned int blocks_chunk_size(long unsigned int length);
+unsigned int blocks_budget(long unsigned int length);
+long unsigned int __blocks_table_size(const frequency_t *table);
+double blocks_cost(const frequency_t *table);
+int blocks_split(frequency_t *chunks, unsigned int count,
+		 long unsigned int chunk_size, long unsigned int length,
+		 unsigned int budget, blocks_t *blocks);
+int blocks_count(FILE *input, long start, long length, codec_t *codec,
+		 blocks_t *blocks, frequency_table_t total);
+int blocks_encode(FILE *input, output_t *output, long start,
+		  const blocks_t *blocks, codec_t *codec);
+int blocks_decode(FILE *file, output_t *output,
+		  const stream_header_t *header, codec_t *codec);
+void blocks_destroy(blocks_t *blocks);
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "huffman/bitstream.h"
+#include "huffman/encoding_table.h"
+#include "huffman/histogram.h"
+#include "huffman/huffman.h"
+#include "huffman/huffman_tree.h"
+#include "huffman/output.h"
+#include "huffman/statistics.h"
+#include "huffman/transform.h"
+#include "types/queue.h"
+
+#define DECODING_TABLE_BITS 11
+#define DECODING_TABLE_SIZE (1 << DECODING_TABLE_BITS)
+// Inputs from which building the pair table pays for itself
+#define CODEC_PAIR_THRESHOLD (256 * 1024)
+// Memory limits below which the pair table is not worth its 512 KiB
+#define CODEC_PAIR_MEMORY (8 * 1024 * 1024)
+
+// Decoding of the next DECODING_TABLE_BITS bits of the stream: either a
+// whole code, or the subtree to walk for codes that are longer.
+typedef struct decoding_t {
+	huffman_tree_t node;
+	symbol_t symbol;
+	unsigned char length;
+} decoding_t;
+
+// Header of a compressed stream. Without filters, every original byte is
+// coded as one symbol. Streams split into blocks list them from
+// `block_list` on; the table read with the header is the first block's.
+typedef struct stream_header_t {
+	long unsigned int file_length;
+	long unsigned int symbol_length;
+	unsigned char filters;
+	unsigned int symbol_count;
+	unsigned int block_count;
+	long unsigned int block_list;
+} stream_header_t;
+
+// Tables derived from a frequency table. They are only rebuilt when the
+// codec is prepared with different frequencies: streams that share a
+// table, like archive members, build them once.
+typedef struct codec_t {
+	frequency_t frequencies[HUFFMAN_MAX_SYMBOLS];
+	huffman_tree_t *huffman_tree;
+	encoding_t encoding_table[HUFFMAN_MAX_SYMBOLS];
+	packed_encoding_t packed_table[HUFFMAN_MAX_SYMBOLS];
+	pair_encoding_t *pair_table;
+	decoding_t *decoding_table;
+	bool ready;
+} codec_t;
+
+queue build_queue(frequency_table_t table);
+huffman_tree_t *build_huffman_tree(queue *queue);
+void build_encoding_table_recursive(const huffman_tree_t huffman_tree,
+				    encoding_table_t encoding_table,
+				    encoding_t *encoding);
+int build_encoding_table(const huffman_tree_t huffman_tree,
+			 encoding_table_t table);
+void build_decoding_table(const huffman_tree_t huffman_tree,
+			  decoding_t *table);
+
+void codec_create(codec_t *codec);
+int codec_prepare(codec_t *codec, frequency_table_t table);
+int codec_prepare_pairs(codec_t *codec);
+void codec_prepare_encoder(codec_t *codec, long unsigned int length);
+long unsigned int codec_coded_size(const codec_t *codec,
+				   const frequency_t *table);
+void codec_destroy(codec_t *codec);
+
+int __write_frequencies(FILE *output, frequency_table_t frequency_table);
+int __read_frequencies(FILE *file, unsigned int *symbol_count,
+		       frequency_table_t *frequency_table);
+int write_header(FILE *output, long unsigned int file_length,
+		 frequency_table_t frequency_table);
+int write_transform_header(FILE *output, long unsigned int file_length,
+			   unsigned char filters,
+			   frequency_table_t frequency_table);
+int read_compressed_file(FILE *file, stream_header_t *header,
+			 frequency_table_t *frequency_table);
+void __encode_buffer(bit_writer_t *writer, codec_t *codec,
+		     const unsigned char *buffer, size_t length);
+int encode_file(FILE *input, FILE *output, unsigned char filters,
+		codec_t *codec);
+int encode_output(FILE *input, long unsigned int length, output_t *output,
+		  unsigned char filters, codec_t *codec);
+int __histogram_transformed(FILE *input, long unsigned int length,
+			    unsigned char filters, frequency_table_t table);
+int __write_stream(FILE *file, output_t *output,
+		   const stream_header_t *header, codec_t *codec);
+int write_file(FILE *file, output_t *output, const stream_header_t *header,
+	       codec_t *codec);
+
+int compress_stream(FILE *input, FILE *output, compression_level_t level,
+		    unsigned char filters, codec_t *codec);
+int compress_output(FILE *input, output_t *output, compression_level_t level,
+		    unsigned char filters, codec_t *codec);
+int compress_range(FILE *input, output_t *output, long start,
+		   compression_level_t level, unsigned char filters,
+		   codec_t *codec);
+
+#endif
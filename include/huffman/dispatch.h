@@ -0,0 +1,30 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <stdbool.h>
+
+#define DISPATCH_ENVIRONMENT "HUFFMAN_CPU"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DISPATCH_X86 1
+#else
+#define DISPATCH_X86 0
+#endif
+
+typedef enum cpu_variant_t {
+	CPU_VARIANT_SCALAR = 0,
+	CPU_VARIANT_SSE42,
+	CPU_VARIANT_AVX2,
+	CPU_VARIANT_AVX512,
+	CPU_VARIANT_COUNT
+} cpu_variant_t;
+
+const char *cpu_variant_name(cpu_variant_t variant);
+int cpu_variant_parse(const char *name, cpu_variant_t *variant);
+bool cpu_variant_supported(cpu_variant_t variant);
+cpu_variant_t cpu_variant_best(void);
+
+int dispatch_select(cpu_variant_t variant);
+cpu_variant_t dispatch_variant(void);
+
+#endif
@@ -2,6 +2,7 @@
 #define ENCODING_TABLE_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "huffman/huffman.h"
 
@@ -12,6 +13,22 @@ typedef struct encoding_t {
 } encoding_t;
 typedef encoding_t *encoding_table_t;
 
+// Codes packed into a word, most significant bit first. A zero length
+// marks a code too long to be packed.
+typedef struct packed_encoding_t {
+	uint64_t bits;
+	unsigned char length;
+} packed_encoding_t;
+typedef packed_encoding_t *packed_encoding_table_t;
+
+// Concatenated codes of a pair of symbols, indexed by (first << 8) |
+// second: the bits above the low byte, the length in the low byte. A
+// zero entry marks a pair too long to be written at once.
+typedef uint64_t pair_encoding_t;
+#define ENCODING_PAIR_TABLE_SIZE (HUFFMAN_MAX_SYMBOLS * HUFFMAN_MAX_SYMBOLS)
+#define PAIR_ENCODING_BITS(pair) ((pair) >> 8)
+#define PAIR_ENCODING_LENGTH(pair) ((unsigned int)((pair) & 0xFF))
+
 void encoding_table_destroy(encoding_table_t table);
 
 encoding_t encoding_create(void);
@@ -25,4 +42,10 @@ encoding_t encoding_copy(encoding_t code);
 void encoding_free(encoding_t *code);
 bool encoding_compare(encoding_t a, encoding_t b);
 
+packed_encoding_t encoding_pack(encoding_t code, int max_length);
+void encoding_table_pack(encoding_table_t table,
+			 packed_encoding_table_t packed, int max_length);
+void encoding_table_pair(const packed_encoding_t *packed,
+			 pair_encoding_t *pairs, int max_length);
+
 #endif
\ No newline at end of file
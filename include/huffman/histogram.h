@@ -0,0 +1,65 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "huffman/dispatch.h"
+#include "huffman/huffman.h"
+#include "huffman/statistics.h"
+
+#define HISTOGRAM_BUFFER_SIZE (64 * 1024)
+#define HISTOGRAM_SAMPLE_CHUNKS 64
+#define HISTOGRAM_SAMPLE_CHUNK_SIZE (64 * 1024)
+// Bytes counted into 32-bit partial counters before they are merged
+#define HISTOGRAM_SLAB_SIZE (1024 * 1024 * 1024)
+#define HISTOGRAM_SAMPLE_THRESHOLD \
+	(4 * HISTOGRAM_SAMPLE_CHUNKS * HISTOGRAM_SAMPLE_CHUNK_SIZE)
+// Smallest range worth a counting thread of its own
+#define HISTOGRAM_PARALLEL_MIN (8 * 1024 * 1024)
+
+typedef enum compression_level_t {
+	COMPRESSION_LEVEL_FAST = 1,
+	COMPRESSION_LEVEL_NORMAL = 9
+} compression_level_t;
+
+typedef void (*histogram_kernel_t)(const unsigned char *buffer,
+				   size_t length, frequency_table_t table);
+
+// Part of a file counted by one thread into its own table, or into the
+// tables of the `chunk_size` chunks it spans when `chunks` is set
+typedef struct histogram_range_t {
+	int fd;
+	off_t start;
+	off_t end;
+	size_t buffer_size;
+	frequency_t table[HUFFMAN_MAX_SYMBOLS];
+	off_t origin;
+	size_t chunk_size;
+	frequency_t *chunks;
+	int status;
+	pthread_t thread;
+	bool started;
+} histogram_range_t;
+
+int compression_level_parse(const char *name, compression_level_t *level);
+
+histogram_kernel_t histogram_kernel(cpu_variant_t variant);
+
+void histogram_count_buffer(const unsigned char *buffer, size_t length,
+			    frequency_table_t table);
+int histogram_count(FILE *file, frequency_table_t table);
+int histogram_count_range(FILE *file, long start, long length,
+			  frequency_table_t table);
+int histogram_count_parallel(int fd, off_t start, off_t end, int threads,
+			     frequency_table_t table);
+int histogram_count_chunks(int fd, off_t start, off_t end, size_t chunk_size,
+			   int threads, frequency_t *chunks);
+int histogram_sample(FILE *file, long start, long length,
+		     frequency_table_t table);
+int histogram_build(FILE *file, compression_level_t level,
+		    frequency_table_t table);
+
+#endif
@@ -3,6 +3,10 @@
 
 #define HUFFMAN_MAGIC "HUFF"
 #define HUFFMAN_MAGIC_SIZE 4
+// Stream whose symbols went through pre-transform filters
+#define HUFFMAN_TRANSFORM_MAGIC "HUFT"
+// Stream split into blocks, each with its own table
+#define HUFFMAN_BLOCKS_MAGIC "HUFB"
 #define HUFFMAN_FILE_EXTENSION ".huff"
 #define HUFFMAN_FILE_EXTENSION_SIZE 5
 
@@ -0,0 +1,37 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Resident memory of the program itself (code, libc, stacks, tables)
+#define MEMORY_BASELINE (2 * 1024 * 1024)
+#define MEMORY_BUFFER_MAX (256 * 1024)
+// Buffers shrink to this size before threads are given up
+#define MEMORY_BUFFER_PREFERRED (64 * 1024)
+#define MEMORY_BUFFER_MIN (4 * 1024)
+// I/O buffers live at the same time in one thread (input, bitstream,
+// output)
+#define MEMORY_BUFFERS_PER_THREAD 4
+#define MEMORY_PHASES 8
+
+// Sizes derived from a memory limit; a limit of 0 means unlimited.
+typedef struct memory_plan_t {
+	size_t limit;
+	size_t buffer_size;
+	size_t map_limit;
+	size_t thread_limit;
+	int threads;
+} memory_plan_t;
+
+int memory_parse_size(const char *text, size_t *size);
+const memory_plan_t *memory_configure(size_t limit, int threads);
+const memory_plan_t *memory_plan(void);
+size_t memory_physical(void);
+
+size_t memory_peak(void);
+void memory_phases_start(void);
+void memory_phase_end(const char *name);
+void memory_phases_report(FILE *stream);
+
+#endif
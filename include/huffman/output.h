@@ -0,0 +1,57 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define OUTPUT_BUFFER_SIZE (1024 * 1024)
+// O_DIRECT writes must start, end and be stored on this boundary
+#define OUTPUT_DIRECT_ALIGNMENT 4096
+
+// Exactly one of `file`, `map` or `direct` receives the bytes. `direct`
+// is an aligned buffer written to `fd` whole, bypassing the page cache.
+typedef struct output_t {
+	int fd;
+	FILE *file;
+	unsigned char *map;
+	unsigned char *direct;
+	size_t direct_length;
+	size_t direct_capacity;
+	int failed;
+	size_t length;
+	size_t position;
+} output_t;
+
+int output_open(output_t *output, const char *filename, size_t length);
+int output_open_buffer(output_t *output, unsigned char *buffer,
+		       size_t length);
+int output_open_direct(output_t *output, const char *filename, size_t length);
+int output_open_stream(output_t *output, FILE *file);
+int output_reserve(output_t *output, size_t length);
+int output_write(output_t *output, const unsigned char *data, size_t length);
+int output_close(output_t *output);
+unsigned char *output_region(output_t *output, size_t offset, size_t length);
+int output_is_mapped(const output_t *output);
+int output_is_direct(const output_t *output);
+void __output_direct_flush(output_t *output);
+
+static inline void output_put(output_t *output, unsigned char c)
+{
+	if (NULL != output->map) {
+		// Past the mapped length, the stream is longer than its header
+		if (output->position < output->length)
+			output->map[output->position] = c;
+		else
+			output->failed = 1;
+	} else if (NULL != output->direct) {
+		output->direct[output->direct_length++] = c;
+		if (output->direct_length == output->direct_capacity)
+			__output_direct_flush(output);
+	} else {
+		fputc(c, output->file);
+	}
+
+	output->position++;
+}
+
+#endif
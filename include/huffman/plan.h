@@ -0,0 +1,37 @@
+#ifndef PLAN_H
+#define PLAN_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "huffman/blocks.h"
+#include "huffman/codec.h"
+#include "huffman/histogram.h"
+#include "huffman/output.h"
+#include "huffman/statistics.h"
+
+// How compress_range encodes a range: one stream through `filters`, with
+// the counts of the filtered symbols, or blocks when `blocks.count` > 1.
+// `header_size` is that of the single stream; `size` is that of the whole
+// output, exact unless the counts were sampled.
+typedef struct compress_plan_t {
+	long unsigned int length;
+	unsigned char filters;
+	bool sampled;
+	frequency_table_t frequency_table;
+	blocks_t blocks;
+	long unsigned int header_size;
+	long unsigned int size;
+} compress_plan_t;
+
+long unsigned int __compress_plan_header_size(unsigned char filters,
+					      long unsigned int length,
+					      const frequency_t *table);
+int compress_plan(FILE *input, long start, compression_level_t level,
+		  unsigned char filters, codec_t *codec,
+		  compress_plan_t *plan);
+int compress_planned(FILE *input, output_t *output, long start,
+		     const compress_plan_t *plan, codec_t *codec);
+void compress_plan_destroy(compress_plan_t *plan);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef SEGMENTS_H
+#define SEGMENTS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "huffman/codec.h"
+#include "huffman/huffman.h"
+#include "huffman/output.h"
+#include "huffman/statistics.h"
+
+// Layout of a file grown by appends: self-contained streams, each coding
+// the bytes added since the previous one and followed by a fixed-size
+// trailer. A trailer holds the offset of its segment, where the previous
+// trailer ends, with the length covered so far and the segment count: an
+// append writes only its own segment and trailer.
+//
+// Before writing its segment, an append marks the file with a record laid
+// out as a trailer but with the pending magic, past the most the segment
+// can take, holding the end of the file before it. An interrupted append
+// leaves that mark at the end of the file: the next one cuts the file back
+// to the end it holds.
+#define SEGMENTS_MAGIC "HUFS"
+#define SEGMENTS_PENDING "HUFP"
+#define SEGMENTS_MAGIC_SIZE 4
+#define SEGMENTS_TRAILER_SIZE \
+	(2 * sizeof(long unsigned int) + sizeof(unsigned int) + \
+	 SEGMENTS_MAGIC_SIZE)
+
+typedef struct segment_t {
+	long unsigned int offset;
+	long unsigned int length;
+} segment_t;
+
+// `length` is the input covered by all the segments, `end` the offset at
+// which the next one is written: past the last trailer, or a single stream
+// without one.
+typedef struct segments_t {
+	segment_t *segments;
+	unsigned int count;
+	long unsigned int length;
+	long unsigned int end;
+} segments_t;
+
+bool segments_present(FILE *file);
+int segments_open(segments_t *segments, FILE *file);
+int segments_decode(const segments_t *segments, FILE *file,
+		    output_t *output, codec_t *codec);
+int segments_append(const char *filename, const char *output_filename,
+		    compression_level_t level, unsigned char filters,
+		    long unsigned int *appended);
+void segments_close(segments_t *segments);
+
+#endif
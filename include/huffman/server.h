@@ -0,0 +1,115 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "huffman/codec.h"
+
+#define SERVER_MAX_PAYLOAD (UINT64_C(1) << 32)
+#define SERVER_BACKLOG 1024
+#define SERVER_LATENCY_SAMPLES 8192
+// Milliseconds between two checks of the stop flag
+#define SERVER_POLL_INTERVAL 100
+// Milliseconds a client may stall in the middle of a request
+#define SERVER_IO_TIMEOUT 5000
+
+typedef enum server_operation_t {
+	SERVER_COMPRESS = 1,
+	SERVER_DECOMPRESS = 2,
+	SERVER_STATS = 3
+} server_operation_t;
+
+typedef enum server_status_t {
+	SERVER_OK = 0,
+	SERVER_ERROR_OPERATION = 1,
+	SERVER_ERROR_PAYLOAD = 2,
+	SERVER_ERROR_MEMORY = 3
+} server_status_t;
+
+// Requests and responses are a fixed header followed by `length` bytes
+// of payload, in host byte order.
+typedef struct server_request_t {
+	uint32_t operation;
+	uint32_t flags;
+	uint64_t length;
+} server_request_t;
+
+typedef struct server_response_t {
+	uint32_t status;
+	uint32_t flags;
+	uint64_t length;
+} server_response_t;
+
+// Request latencies in microseconds, over the last SERVER_LATENCY_SAMPLES
+// requests
+typedef struct server_latency_t {
+	long unsigned int count;
+	double p50;
+	double p90;
+	double p99;
+	double p999;
+	double max;
+} server_latency_t;
+
+typedef struct server_t server_t;
+
+// Per-thread buffers and codecs, kept across requests: a payload with the
+// same frequency table as the previous one skips the table rebuild
+typedef struct server_worker_t {
+	server_t *server;
+	pthread_t thread;
+	unsigned char *input;
+	size_t input_capacity;
+	unsigned char *output;
+	size_t output_capacity;
+	codec_t encoder;
+	codec_t decoder;
+} server_worker_t;
+
+struct server_t {
+	int fd;
+	char *path;
+	volatile sig_atomic_t stopping;
+
+	int worker_count;
+	server_worker_t *workers;
+
+	// Workers serve one request at a time: server_run polls the idle
+	// connections and queues the readable ones, and workers hand them
+	// back through the `returned` pipe, or -1 once they are closed.
+	struct pollfd polled[SERVER_BACKLOG + 2];
+	size_t idle_count;
+	size_t connection_count;
+	int returned[2];
+
+	pthread_mutex_t lock;
+	pthread_cond_t ready;
+	int pending[SERVER_BACKLOG];
+	size_t pending_head;
+	size_t pending_count;
+
+	pthread_mutex_t latency_lock;
+	double latencies[SERVER_LATENCY_SAMPLES];
+	long unsigned int latency_count;
+};
+
+int server_create(server_t *server, const char *path, int worker_count);
+int server_run(server_t *server);
+void server_stop(server_t *server);
+void server_destroy(server_t *server);
+void server_latency(server_t *server, server_latency_t *latency);
+
+uint64_t __server_max_payload(const server_t *server);
+int __server_read(int fd, void *buffer, size_t length);
+int __server_write(int fd, const void *buffer, size_t length);
+
+int client_connect(const char *path);
+int client_request(int fd, server_operation_t operation,
+		   const unsigned char *payload, size_t length,
+		   unsigned char **response, size_t *response_length);
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "huffman/output.h"
+
+// Filters, applied in this order before entropy coding (and in reverse
+// order after decoding)
+#define TRANSFORM_NONE 0x00
+#define TRANSFORM_DELTA 0x01
+#define TRANSFORM_MTF 0x02
+#define TRANSFORM_RLE 0x04
+#define TRANSFORM_ALL (TRANSFORM_DELTA | TRANSFORM_MTF | TRANSFORM_RLE)
+// Not a filter: let transform_select() choose
+#define TRANSFORM_AUTO 0x80
+
+// After two equal bytes, RLE emits the number of further repetitions
+#define TRANSFORM_RLE_RUN 2
+#define TRANSFORM_RLE_MAX 255
+
+#define TRANSFORM_SAMPLE_CHUNKS 8
+#define TRANSFORM_SAMPLE_CHUNK_SIZE (32 * 1024)
+// A filter set must save this fraction of the estimated size to be used
+#define TRANSFORM_SAMPLE_MARGIN 0.01
+
+typedef struct transform_t {
+	unsigned char filters;
+	unsigned char previous;
+	unsigned char order[256];
+	int run_symbol;
+	unsigned int run_length;
+	unsigned int run_count;
+	bool run_counting;
+} transform_t;
+
+typedef struct transform_reader_t {
+	FILE *file;
+	transform_t transform;
+	unsigned char *raw;
+	size_t raw_size;
+	unsigned char *buffer;
+	long unsigned int remaining;
+	bool finished;
+} transform_reader_t;
+
+int transform_parse(const char *names, unsigned char *filters);
+void transform_names(unsigned char filters, char *buffer, size_t size);
+
+void transform_create(transform_t *transform, unsigned char filters);
+size_t transform_bound(size_t length);
+size_t transform_forward(transform_t *transform, const unsigned char *input,
+			 size_t length, unsigned char *output);
+size_t transform_flush(transform_t *transform, unsigned char *output);
+unsigned char transform_select(FILE *file, long start, long length);
+
+int transform_reader_create(transform_reader_t *reader, FILE *file,
+			    long unsigned int length, unsigned char filters,
+			    size_t size);
+size_t transform_reader_read(transform_reader_t *reader,
+			     const unsigned char **data);
+void transform_reader_destroy(transform_reader_t *reader);
+
+static inline unsigned char __transform_inverse_byte(transform_t *transform,
+						     unsigned char byte)
+{
+	if (transform->filters & TRANSFORM_MTF) {
+		unsigned char index = byte;
+		byte = transform->order[index];
+		for (; index > 0; index--) {
+			transform->order[index] = transform->order[index - 1];
+		}
+		transform->order[0] = byte;
+	}
+
+	if (transform->filters & TRANSFORM_DELTA) {
+		byte = (unsigned char)(byte + transform->previous);
+		transform->previous = byte;
+	}
+
+	return byte;
+}
+
+// Undoes the filters for one decoded byte, writing whatever original
+// bytes it stands for. A corrupt stream cannot write past the output.
+static inline void transform_inverse_put(transform_t *transform,
+					 output_t *output, unsigned char byte)
+{
+	if (output->position >= output->length)
+		return;
+
+	if (!(transform->filters & TRANSFORM_RLE)) {
+		output_put(output, __transform_inverse_byte(transform, byte));
+		return;
+	}
+
+	if (transform->run_counting) {
+		unsigned char symbol = transform->run_symbol;
+		for (unsigned int i = 0;
+		     i < byte && output->position < output->length; i++) {
+			output_put(output,
+				   __transform_inverse_byte(transform, symbol));
+		}
+		transform->run_counting = false;
+		transform->run_symbol = -1;
+		transform->run_length = 0;
+		return;
+	}
+
+	output_put(output, __transform_inverse_byte(transform, byte));
+
+	if (byte == transform->run_symbol) {
+		transform->run_length++;
+	} else {
+		transform->run_symbol = byte;
+		transform->run_length = 1;
+	}
+	transform->run_counting = TRANSFORM_RLE_RUN == transform->run_length;
+}
+
+#endif
@@ -0,0 +1,145 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "huffman/analysis.h"
+#include "huffman/codec.h"
+#include "huffman/histogram.h"
+#include "huffman/huffman.h"
+#include "huffman/plan.h"
+#include "huffman/statistics.h"
+#include "huffman/transform.h"
+
+double __analysis_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Seconds per byte of encode_file, timed on the head of the input
+double __analysis_encode_rate(FILE *input, long unsigned int length,
+			      unsigned char filters, codec_t *codec)
+{
+	size_t size = length < ANALYSIS_CALIBRATION_SIZE ?
+	    length : ANALYSIS_CALIBRATION_SIZE;
+	unsigned char *buffer = malloc(size);
+	if (NULL == buffer || 0 != fseek(input, 0, SEEK_SET)
+	    || fread(buffer, 1, size, input) != size) {
+		free(buffer);
+		return 0;
+	}
+
+	double rate = 0;
+	FILE *head = fmemopen(buffer, size, "r");
+	FILE *sink = fopen("/dev/null", "w");
+	if (NULL != head && NULL != sink) {
+		double start = __analysis_now();
+		if (0 == encode_file(head, sink, filters, codec))
+			rate = (__analysis_now() - start) / size;
+	}
+
+	if (NULL != head)
+		fclose(head);
+	if (NULL != sink)
+		fclose(sink);
+	free(buffer);
+
+	return rate;
+}
+
+int analyze_stream(FILE *input, compression_level_t level,
+		   unsigned char filters, codec_t *codec,
+		   analysis_t *analysis)
+{
+	memset(analysis, 0, sizeof(*analysis));
+
+	// Planned as compress would: same filters, same blocks
+	compress_plan_t plan;
+	double start = __analysis_now();
+	if (0 != compress_plan(input, 0, level, filters, codec, &plan))
+		return -1;
+	analysis->count_time = __analysis_now() - start;
+
+	analysis->file_length = plan.length;
+	analysis->sampled = plan.sampled;
+	analysis->filters = plan.filters;
+	analysis->header_size = plan.header_size;
+	analysis->block_count = plan.blocks.count > 1 ? plan.blocks.count : 1;
+	analysis->blocks_size = plan.blocks.size;
+	analysis->compressed_size = plan.size;
+
+	int status = 0;
+	if (0 == plan.length)
+		goto finalize;
+
+	if (0 != codec_prepare(codec, plan.frequency_table)) {
+		status = -1;
+		goto finalize;
+	}
+
+	// Entropy and code lengths of the (possibly scaled) counts
+	frequency_t total = 0;
+	for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++) {
+		total += plan.frequency_table[i];
+	}
+
+	for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++) {
+		if (0 == plan.frequency_table[i])
+			continue;
+
+		unsigned int length =
+		    encoding_length(codec->encoding_table[i]);
+		double probability = (double)plan.frequency_table[i] / total;
+		analysis->symbol_count++;
+		analysis->entropy -= probability * log2(probability);
+		if (length > analysis->max_code_length)
+			analysis->max_code_length = length;
+	}
+
+	analysis->coded_size = codec_coded_size(codec, plan.frequency_table);
+
+	// Compressing repeats the counting pass and encodes every byte
+	codec_prepare_encoder(codec, plan.length);
+	double rate = __analysis_encode_rate(input, plan.length, plan.filters,
+					     codec);
+	analysis->estimated_time = analysis->count_time + rate * plan.length;
+
+ finalize:;
+	compress_plan_destroy(&plan);
+	fseek(input, 0, SEEK_SET);
+
+	return status;
+}
+
+void analysis_print(FILE *output, const char *name,
+		    const analysis_t *analysis)
+{
+	double ratio = 0 == analysis->file_length ? 1.0 :
+	    (double)analysis->compressed_size / analysis->file_length;
+
+	fprintf(output, "File: %s\n", name);
+	fprintf(output, "Length: %lu bytes\n", analysis->file_length);
+	fprintf(output, "Counts: %s\n", analysis->sampled ? "sampled" :
+		"exact");
+	char names[64];
+	transform_names(analysis->filters, names, sizeof(names));
+	fprintf(output, "Filters: %s\n", names);
+	fprintf(output, "Symbols: %u\n", analysis->symbol_count);
+	fprintf(output, "Entropy: %.4f bits/byte\n", analysis->entropy);
+	fprintf(output, "Max code length: %u bits\n",
+		analysis->max_code_length);
+	fprintf(output, "Header size: %lu bytes\n", analysis->header_size);
+	fprintf(output, "Coded size: %lu bytes\n", analysis->coded_size);
+	if (analysis->block_count > 1)
+		fprintf(output, "Blocks: %u, %lu bytes\n",
+			analysis->block_count, analysis->blocks_size);
+	fprintf(output, "Compressed size: %lu bytes (%.2f%%)\n",
+		analysis->compressed_size, 100 * ratio);
+	fprintf(output, "Estimated time: %.3fs\n", analysis->estimated_time);
+}
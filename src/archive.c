@@ -0,0 +1,513 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "huffman/archive.h"
+#include "huffman/codec.h"
+#include "huffman/histogram.h"
+#include "huffman/huffman.h"
+#include "huffman/memory.h"
+#include "huffman/output.h"
+#include "huffman/statistics.h"
+#include "huffman/transform.h"
+
+int archive_table_parse(const char *name, archive_table_t *table)
+{
+	if (0 == strcmp(name, "auto"))
+		*table = ARCHIVE_TABLE_AUTO;
+	else if (0 == strcmp(name, "own"))
+		*table = ARCHIVE_TABLE_OWN;
+	else if (0 == strcmp(name, "shared"))
+		*table = ARCHIVE_TABLE_SHARED;
+	else
+		return -1;
+
+	return 0;
+}
+
+// Stored names are relative: leading "/" and "./" are dropped
+const char *__archive_name(const char *path)
+{
+	for (;;) {
+		if ('/' == path[0])
+			path++;
+		else if ('.' == path[0] && '/' == path[1])
+			path += 2;
+		else
+			return path;
+	}
+}
+
+// Names never leave the destination directory
+bool __archive_name_safe(const char *name)
+{
+	size_t length = strlen(name);
+	return length > 0 && '/' != name[0] && 0 != strcmp(name, "..")
+	    && 0 != strncmp(name, "../", 3) && NULL == strstr(name, "/../")
+	    && !(length >= 3 && 0 == strcmp(name + length - 3, "/.."));
+}
+
+long unsigned int __archive_header_size(const frequency_t *table)
+{
+	long unsigned int size = HUFFMAN_MAGIC_SIZE + HUFFMAN_FILE_LENGTH_SIZE;
+	bool empty = true;
+	for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++) {
+		if (0 != table[i]) {
+			size += HUFFMAN_SYMBOL_SIZE + HUFFMAN_FREQUENCY_SIZE;
+			empty = false;
+		}
+	}
+
+	return empty ? size : size + HUFFMAN_SYMBOL_COUNT_SIZE;
+}
+
+int __archive_write_directory(FILE *output, const archive_member_t *members,
+			      unsigned int count,
+			      long unsigned int shared_offset)
+{
+	long unsigned int directory_offset = ftell(output);
+
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned short name_length = strlen(members[i].name);
+		fwrite(&name_length, sizeof(name_length), 1, output);
+		fwrite(members[i].name, sizeof(char), name_length, output);
+		fwrite(&members[i].length, sizeof(members[i].length), 1,
+		       output);
+		fwrite(&members[i].offset, sizeof(members[i].offset), 1,
+		       output);
+		fwrite(&members[i].size, sizeof(members[i].size), 1, output);
+		fwrite(&members[i].flags, sizeof(members[i].flags), 1, output);
+	}
+
+	// Trailer
+	fwrite(&directory_offset, sizeof(directory_offset), 1, output);
+	fwrite(&shared_offset, sizeof(shared_offset), 1, output);
+	fwrite(&count, sizeof(count), 1, output);
+	fwrite(ARCHIVE_MAGIC, sizeof(char), ARCHIVE_MAGIC_SIZE, output);
+
+	return ferror(output) ? -1 : 0;
+}
+
+int archive_create(const char *filename, char *const *paths, int count,
+		   archive_table_t table)
+{
+	frequency_t *tables = calloc(count + 1,
+				     HUFFMAN_MAX_SYMBOLS * sizeof(frequency_t));
+	archive_member_t *members = calloc(count, sizeof(archive_member_t));
+	if (NULL == tables || NULL == members) {
+		free(tables);
+		free(members);
+		return -1;
+	}
+
+	// Counting pass: one table per member, and their sum
+	frequency_t *shared = tables + count * HUFFMAN_MAX_SYMBOLS;
+	int status = -1;
+	for (int i = 0; i < count; i++) {
+		// Absolute names are stored relative; names that would escape
+		// the destination, or extract over another member, are refused
+		members[i].name = (char *)__archive_name(paths[i]);
+		if (strlen(members[i].name) > ARCHIVE_NAME_MAX
+		    || !__archive_name_safe(members[i].name))
+			goto finalize;
+		for (int j = 0; j < i; j++) {
+			if (0 == strcmp(members[i].name, members[j].name))
+				goto finalize;
+		}
+
+		FILE *input = fopen(paths[i], "r");
+		if (NULL == input)
+			goto finalize;
+
+		frequency_t *member = tables + i * HUFFMAN_MAX_SYMBOLS;
+		int counted = histogram_count(input, member);
+		fclose(input);
+		if (0 != counted)
+			goto finalize;
+
+		for (int j = 0; j < HUFFMAN_MAX_SYMBOLS; j++) {
+			members[i].length += member[j];
+			shared[j] += member[j];
+		}
+	}
+	memory_phase_end("count");
+
+	codec_t shared_codec, codec;
+	codec_create(&shared_codec);
+	codec_create(&codec);
+	codec_prepare(&shared_codec, shared);
+
+	// A member takes the shared table when that is no larger than its
+	// own table plus header
+	bool has_shared = false;
+	for (int i = 0; i < count; i++) {
+		frequency_t *member = tables + i * HUFFMAN_MAX_SYMBOLS;
+		bool use_shared = ARCHIVE_TABLE_SHARED == table;
+		if (ARCHIVE_TABLE_AUTO == table) {
+			codec_prepare(&codec, member);
+			use_shared = 0 == members[i].length
+			    || codec_coded_size(&shared_codec, member) <=
+			    __archive_header_size(member) +
+			    codec_coded_size(&codec, member);
+		}
+
+		if (use_shared) {
+			members[i].flags |= ARCHIVE_MEMBER_SHARED;
+			has_shared = has_shared || 0 != members[i].length;
+		}
+	}
+	memory_phase_end("tables");
+
+	FILE *output = fopen(filename, "w");
+	if (NULL == output)
+		goto finalize_codecs;
+
+	fwrite(ARCHIVE_MAGIC, sizeof(char), ARCHIVE_MAGIC_SIZE, output);
+	long unsigned int shared_offset = 0;
+	if (has_shared) {
+		shared_offset = ftell(output);
+		__write_frequencies(output, shared);
+		long unsigned int shared_length = 0;
+		for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++) {
+			shared_length += shared[i];
+		}
+		codec_prepare_encoder(&shared_codec, shared_length);
+	}
+
+	for (int i = 0; i < count; i++) {
+		members[i].offset = ftell(output);
+		frequency_t *member = tables + i * HUFFMAN_MAX_SYMBOLS;
+		bool use_shared = members[i].flags & ARCHIVE_MEMBER_SHARED;
+
+		if (!use_shared
+		    && 0 != write_header(output, members[i].length, member))
+			goto finalize_output;
+
+		if (0 != members[i].length) {
+			FILE *input = fopen(paths[i], "r");
+			if (NULL == input)
+				goto finalize_output;
+
+			codec_t *member_codec = &shared_codec;
+			if (!use_shared) {
+				codec_prepare(&codec, member);
+				codec_prepare_encoder(&codec,
+						      members[i].length);
+				member_codec = &codec;
+			}
+
+			// Only the counted bytes, should the file have grown
+			output_t stream;
+			output_open_stream(&stream, output);
+			int encoded = encode_output(input, members[i].length,
+						    &stream, TRANSFORM_NONE,
+						    member_codec);
+			fclose(input);
+			if (0 != encoded)
+				goto finalize_output;
+		}
+
+		members[i].size = ftell(output) - members[i].offset;
+	}
+	memory_phase_end("encode");
+
+	status = __archive_write_directory(output, members, count,
+					   shared_offset);
+
+ finalize_output:;
+	if (0 != fclose(output))
+		status = -1;
+ finalize_codecs:;
+	codec_destroy(&shared_codec);
+	codec_destroy(&codec);
+ finalize:;
+	free(tables);
+	free(members);
+
+	return status;
+}
+
+int archive_open(archive_t *archive, const char *filename)
+{
+	memset(archive, 0, sizeof(*archive));
+
+	FILE *file = fopen(filename, "r");
+	if (NULL == file)
+		return -1;
+
+	// Only the trailer and the directory are read
+	long unsigned int directory_offset = 0;
+	char magic[ARCHIVE_MAGIC_SIZE];
+	if (0 != fseek(file, -(long)ARCHIVE_TRAILER_SIZE, SEEK_END)
+	    || fread(&directory_offset, sizeof(directory_offset), 1, file) != 1
+	    || fread(&archive->shared_offset, sizeof(archive->shared_offset),
+		     1, file) != 1
+	    || fread(&archive->count, sizeof(archive->count), 1, file) != 1
+	    || fread(magic, sizeof(char), ARCHIVE_MAGIC_SIZE, file) !=
+	    ARCHIVE_MAGIC_SIZE
+	    || 0 != strncmp(magic, ARCHIVE_MAGIC, ARCHIVE_MAGIC_SIZE))
+		goto fail;
+
+	long directory_end = ftell(file) - ARCHIVE_TRAILER_SIZE;
+	if (directory_offset > (long unsigned int)directory_end
+	    || 0 != fseek(file, directory_offset, SEEK_SET))
+		goto fail;
+
+	archive->filename = strdup(filename);
+	archive->members = calloc(archive->count, sizeof(archive_member_t));
+	if (NULL == archive->filename
+	    || (0 != archive->count && NULL == archive->members))
+		goto fail;
+
+	for (unsigned int i = 0; i < archive->count; i++) {
+		archive_member_t *member = &archive->members[i];
+		unsigned short name_length = 0;
+		if (fread(&name_length, sizeof(name_length), 1, file) != 1
+		    || name_length > ARCHIVE_NAME_MAX)
+			goto fail;
+
+		member->name = malloc(name_length + 1);
+		if (NULL == member->name
+		    || fread(member->name, sizeof(char), name_length,
+			     file) != name_length)
+			goto fail;
+		member->name[name_length] = '\0';
+
+		if (fread(&member->length, sizeof(member->length), 1, file) !=
+		    1
+		    || fread(&member->offset, sizeof(member->offset), 1,
+			     file) != 1
+		    || fread(&member->size, sizeof(member->size), 1, file) != 1
+		    || fread(&member->flags, sizeof(member->flags), 1,
+			     file) != 1)
+			goto fail;
+
+		if (member->offset + member->size > directory_offset)
+			goto fail;
+	}
+
+	fclose(file);
+	return 0;
+
+ fail:;
+	fclose(file);
+	archive_close(archive);
+	return -1;
+}
+
+int archive_find(const archive_t *archive, const char *name)
+{
+	name = __archive_name(name);
+	for (unsigned int i = 0; i < archive->count; i++) {
+		if (0 == strcmp(archive->members[i].name, name))
+			return i;
+	}
+
+	return -1;
+}
+
+int __archive_load_shared(archive_t *archive)
+{
+	if (NULL != archive->shared)
+		return 0;
+	if (0 == archive->shared_offset)
+		return -1;
+
+	FILE *file = fopen(archive->filename, "r");
+	if (NULL == file)
+		return -1;
+
+	unsigned int symbol_count = 0;
+	int status = -1;
+	if (0 == fseek(file, archive->shared_offset, SEEK_SET))
+		status = __read_frequencies(file, &symbol_count,
+					    &archive->shared);
+	fclose(file);
+
+	return status;
+}
+
+// Creates the missing parent directories of `path`
+int __archive_make_parents(char *path)
+{
+	for (char *slash = strchr(path + 1, '/'); NULL != slash;
+	     slash = strchr(slash + 1, '/')) {
+		*slash = '\0';
+		int status = mkdir(path, 0777);
+		*slash = '/';
+		if (0 != status && EEXIST != errno)
+			return -1;
+	}
+
+	return 0;
+}
+
+int archive_extract_member(archive_t *archive, FILE *file, unsigned int index,
+			   const char *directory, codec_t *codec)
+{
+	archive_member_t *member = &archive->members[index];
+
+	const char *name = member->name;
+	if (!__archive_name_safe(name))
+		return -1;
+
+	size_t length = strlen(directory) + strlen(name) + 2;
+	char *path = malloc(length);
+	if (NULL == path)
+		return -1;
+	snprintf(path, length, "%s/%s", directory, name);
+
+	int status = -1;
+	stream_header_t header = {.file_length = member->length,
+		.symbol_length = member->length,.filters = TRANSFORM_NONE,
+		.symbol_count = 0
+	};
+	frequency_table_t frequency_table = NULL;
+
+	if (0 != __archive_make_parents(path)
+	    || 0 != fseek(file, member->offset, SEEK_SET))
+		goto finalize;
+
+	if (member->flags & ARCHIVE_MEMBER_SHARED) {
+		if (0 != member->length
+		    && 0 != codec_prepare(codec, archive->shared))
+			goto finalize;
+	} else {
+		if (0 != read_compressed_file(file, &header, &frequency_table)
+		    || header.file_length != member->length)
+			goto finalize;
+		if (0 != header.file_length
+		    && 0 != codec_prepare(codec, frequency_table))
+			goto finalize;
+	}
+
+	output_t output;
+	if (0 != output_open(&output, path, member->length))
+		goto finalize;
+	status = write_file(file, &output, &header, codec);
+	if (0 != output_close(&output))
+		status = -1;
+
+ finalize:;
+	frequencies_destroy(&frequency_table);
+	free(path);
+
+	return status;
+}
+
+typedef struct archive_job_t {
+	archive_t *archive;
+	const unsigned int *indices;
+	unsigned int count;
+	const char *directory;
+	pthread_mutex_t lock;
+	unsigned int next;
+	int status;
+} archive_job_t;
+
+void *__archive_work(void *argument)
+{
+	archive_job_t *job = argument;
+	codec_t codec;
+	codec_create(&codec);
+
+	// One stream per thread: members are read without seeking each
+	// other's position
+	FILE *file = fopen(job->archive->filename, "r");
+	int status = NULL == file ? -1 : 0;
+
+	for (;;) {
+		pthread_mutex_lock(&job->lock);
+		unsigned int next = job->next++;
+		pthread_mutex_unlock(&job->lock);
+		if (next >= job->count || NULL == file)
+			break;
+
+		if (0 != archive_extract_member(job->archive, file,
+						job->indices[next],
+						job->directory, &codec))
+			status = -1;
+	}
+
+	if (NULL != file)
+		fclose(file);
+	codec_destroy(&codec);
+
+	pthread_mutex_lock(&job->lock);
+	if (0 != status)
+		job->status = -1;
+	pthread_mutex_unlock(&job->lock);
+
+	return NULL;
+}
+
+int archive_extract(archive_t *archive, const unsigned int *indices,
+		    unsigned int count, const char *directory, int threads)
+{
+	for (unsigned int i = 0; i < count; i++) {
+		if (indices[i] >= archive->count)
+			return -1;
+		// Two threads must not write the same path
+		for (unsigned int j = 0; j < i; j++) {
+			if (0 == strcmp(archive->members[indices[i]].name,
+					archive->members[indices[j]].name))
+				return -1;
+		}
+		// The shared table is read once, before the threads start
+		if ((archive->members[indices[i]].flags & ARCHIVE_MEMBER_SHARED)
+		    && 0 != archive->members[indices[i]].length
+		    && 0 != __archive_load_shared(archive))
+			return -1;
+	}
+
+	if (threads < 1)
+		threads = 1;
+	if ((unsigned int)threads > count)
+		threads = count;
+
+	archive_job_t job = {.archive = archive,.indices = indices,
+		.count = count,.directory = directory,.next = 0,.status = 0
+	};
+	pthread_mutex_init(&job.lock, NULL);
+
+	pthread_t *workers = malloc(threads * sizeof(pthread_t));
+	int started = 0;
+	if (NULL != workers) {
+		for (; started < threads; started++) {
+			if (0 != pthread_create(&workers[started], NULL,
+						__archive_work, &job))
+				break;
+		}
+	}
+
+	// Without any thread, extract in the calling one
+	if (0 == started && count > 0)
+		__archive_work(&job);
+
+	for (int i = 0; i < started; i++) {
+		pthread_join(workers[i], NULL);
+	}
+
+	free(workers);
+	pthread_mutex_destroy(&job.lock);
+
+	return job.status;
+}
+
+void archive_close(archive_t *archive)
+{
+	for (unsigned int i = 0;
+	     NULL != archive->members && i < archive->count; i++) {
+		free(archive->members[i].name);
+	}
+	free(archive->members);
+	free(archive->filename);
+	frequencies_destroy(&archive->shared);
+	memset(archive, 0, sizeof(*archive));
+}
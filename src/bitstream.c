@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "huffman/bitstream.h"
+#include "huffman/memory.h"
+
+int bit_writer_create(bit_writer_t *writer, FILE *file)
+{
+	output_open_stream(&writer->stream, file);
+	return bit_writer_create_output(writer, &writer->stream);
+}
+
+int bit_writer_create_output(bit_writer_t *writer, output_t *output)
+{
+	writer->output = output;
+	writer->accumulator = 0;
+	writer->count = 0;
+	writer->length = 0;
+	writer->capacity = memory_plan()->buffer_size;
+	writer->failed = 0;
+	writer->buffer = malloc(writer->capacity);
+
+	// GCOV_EXCL_START
+	if (NULL == writer->buffer)
+		return -1;
+	// GCOV_EXCL_STOP
+
+	return 0;
+}
+
+int __bit_writer_write(bit_writer_t *writer)
+{
+	if (0 == writer->length)
+		return 0;
+
+	int status = output_write(writer->output, writer->buffer,
+				  writer->length);
+	writer->length = 0;
+	if (0 != status)
+		writer->failed = 1;
+
+	return status;
+}
+
+int bit_writer_flush(bit_writer_t *writer)
+{
+	__bit_writer_drain(writer);
+
+	// The last byte is padded with zeros
+	if (writer->count > 0) {
+		if (writer->length == writer->capacity)
+			__bit_writer_write(writer);
+
+		writer->buffer[writer->length++] =
+		    (unsigned char)(writer->accumulator >> 56);
+		writer->accumulator = 0;
+		writer->count = 0;
+	}
+
+	__bit_writer_write(writer);
+	return writer->failed ? -1 : 0;
+}
+
+void bit_writer_destroy(bit_writer_t *writer)
+{
+	free(writer->buffer);
+	writer->buffer = NULL;
+	writer->output = NULL;
+}
+
+int bit_reader_create(bit_reader_t *reader, FILE *file)
+{
+	reader->file = file;
+	reader->accumulator = 0;
+	reader->count = 0;
+	reader->position = 0;
+	reader->length = 0;
+	reader->capacity = memory_plan()->buffer_size;
+	reader->buffer = malloc(reader->capacity);
+
+	// GCOV_EXCL_START
+	if (NULL == reader->buffer)
+		return -1;
+	// GCOV_EXCL_STOP
+
+	return 0;
+}
+
+void __bit_reader_fill(bit_reader_t *reader)
+{
+	size_t remaining = reader->length - reader->position;
+	memmove(reader->buffer, reader->buffer + reader->position, remaining);
+	reader->position = 0;
+	reader->length = remaining;
+
+	if (NULL != reader->file) {
+		reader->length += fread(reader->buffer + remaining, 1,
+					reader->capacity - remaining,
+					reader->file);
+	}
+
+	// Past the end of the file, the stream reads as zeros
+	if (reader->length < 8) {
+		memset(reader->buffer + reader->length, 0, 8 - reader->length);
+		reader->length = 8;
+		reader->file = NULL;
+	}
+}
+
+void bit_reader_destroy(bit_reader_t *reader)
+{
+	free(reader->buffer);
+	reader->buffer = NULL;
+	reader->file = NULL;
+}
@@ -0,0 +1,424 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "huffman/bitstream.h"
+#include "huffman/blocks.h"
+#include "huffman/codec.h"
+#include "huffman/histogram.h"
+#include "huffman/huffman.h"
+#include "huffman/memory.h"
+#include "huffman/output.h"
+#include "huffman/statistics.h"
+#include "huffman/transform.h"
+
+#define BLOCKS_TABLE_SIZE (HUFFMAN_MAX_SYMBOLS * sizeof(frequency_t))
+
+bool blocks_eligible(FILE *input, long length)
+{
+	// Splitting needs the chunks to be read in place: the payloads the
+	// server opens with fmemopen() have no descriptor, and keep a single
+	// table
+	const memory_plan_t *plan = memory_plan();
+	struct stat info;
+	int fd = fileno(input);
+	return fd >= 0 && 0 == fstat(fd, &info) && S_ISREG(info.st_mode)
+	    && length >= 2 * BLOCKS_CHUNK_SIZE
+	    && (0 == plan->limit || plan->limit >= BLOCKS_MEMORY);
+}
+
+long unsigned int blocks_chunk_size(long unsigned int length)
+{
+	long unsigned int size = BLOCKS_CHUNK_SIZE;
+	while (length / size >= BLOCKS_MAX_CHUNKS) {
+		size *= 2;
+	}
+
+	return size;
+}
+
+// Whether a block pays for its table is up to blocks_split(): the budget
+// only bounds the number of table setups
+unsigned int blocks_budget(long unsigned int length)
+{
+	long unsigned int budget = length / BLOCKS_MIN_LENGTH;
+	return budget < 2 ? 2 : budget > UINT_MAX ? UINT_MAX :
+	    (unsigned int)budget;
+}
+
+// Bytes of a table as written in a stream
+long unsigned int __blocks_table_size(const frequency_t *table)
+{
+	long unsigned int size = HUFFMAN_SYMBOL_COUNT_SIZE;
+	for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++) {
+		if (0 != table[i])
+			size += HUFFMAN_SYMBOL_SIZE + HUFFMAN_FREQUENCY_SIZE;
+	}
+
+	return size;
+}
+
+double blocks_cost(const frequency_t *table)
+{
+	frequency_t total = 0;
+	for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++) {
+		total += table[i];
+	}
+	if (0 == total)
+		return 0;
+
+	// Order-0 entropy of the block, plus its table and header entry
+	double bits = 0;
+	for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++) {
+		if (0 != table[i])
+			bits += table[i] * log2((double)total / table[i]);
+	}
+
+	return bits / 8 + __blocks_table_size(table) + BLOCKS_ENTRY_SIZE;
+}
+
+// Bytes saved by coding two neighbours with one table
+double __blocks_gain(const frequency_t *a, const frequency_t *b,
+		     double cost_a, double cost_b)
+{
+	frequency_t merged[HUFFMAN_MAX_SYMBOLS];
+	for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++) {
+		merged[i] = a[i] + b[i];
+	}
+
+	return cost_a + cost_b - blocks_cost(merged);
+}
+
+int blocks_split(frequency_t *chunks, unsigned int count,
+		 long unsigned int chunk_size, long unsigned int length,
+		 unsigned int budget, blocks_t *blocks)
+{
+	blocks->blocks = NULL;
+	blocks->count = 0;
+	blocks->size = 0;
+
+	double *costs = malloc(count * sizeof(double));
+	double *gains = malloc(count * sizeof(double));
+	unsigned int *next = malloc(count * sizeof(unsigned int));
+	unsigned int *previous = malloc(count * sizeof(unsigned int));
+	long unsigned int *lengths = malloc(count * sizeof(long unsigned int));
+	int status = -1;
+	if (NULL == costs || NULL == gains || NULL == next || NULL == previous
+	    || NULL == lengths)
+		goto finalize;
+
+	// Every chunk starts as a block of its own, in a list where `count`
+	// ends it
+	for (unsigned int i = 0; i < count; i++) {
+		costs[i] = blocks_cost(chunks + i * HUFFMAN_MAX_SYMBOLS);
+		next[i] = i + 1;
+		previous[i] = 0 == i ? count : i - 1;
+		lengths[i] = i + 1 < count ? chunk_size :
+		    length - (count - 1) * chunk_size;
+	}
+	for (unsigned int i = 0; i + 1 < count; i++) {
+		gains[i] = __blocks_gain(chunks + i * HUFFMAN_MAX_SYMBOLS,
+					 chunks + (i + 1) * HUFFMAN_MAX_SYMBOLS,
+					 costs[i], costs[i + 1]);
+	}
+
+	// Neighbours are merged best first, for as long as that saves bytes
+	// or there are more blocks than the budget allows
+	unsigned int remaining = count;
+	while (remaining > 1) {
+		unsigned int best = count;
+		for (unsigned int i = 0; next[i] < count; i = next[i]) {
+			if (count == best || gains[i] > gains[best])
+				best = i;
+		}
+		if (gains[best] < 0 && remaining <= budget)
+			break;
+
+		unsigned int merged = next[best];
+		frequency_t *table = chunks + best * HUFFMAN_MAX_SYMBOLS;
+		for (int j = 0; j < HUFFMAN_MAX_SYMBOLS; j++) {
+			table[j] += chunks[merged * HUFFMAN_MAX_SYMBOLS + j];
+		}
+		costs[best] = blocks_cost(table);
+		lengths[best] += lengths[merged];
+		next[best] = next[merged];
+		if (next[best] < count)
+			previous[next[best]] = best;
+		remaining--;
+
+		if (next[best] < count)
+			gains[best] = __blocks_gain(table, chunks +
+						    next[best] *
+						    HUFFMAN_MAX_SYMBOLS,
+						    costs[best],
+						    costs[next[best]]);
+		if (previous[best] < count)
+			gains[previous[best]] =
+			    __blocks_gain(chunks +
+					  previous[best] * HUFFMAN_MAX_SYMBOLS,
+					  table, costs[previous[best]],
+					  costs[best]);
+	}
+
+	blocks->blocks = malloc(remaining * sizeof(block_t));
+	if (NULL == blocks->blocks)
+		goto finalize;
+
+	for (unsigned int i = 0; i < count; i = next[i]) {
+		block_t *block = &blocks->blocks[blocks->count++];
+		block->length = lengths[i];
+		block->size = 0;
+		memcpy(block->table, chunks + i * HUFFMAN_MAX_SYMBOLS,
+		       BLOCKS_TABLE_SIZE);
+	}
+	status = 0;
+
+ finalize:;
+	free(costs);
+	free(gains);
+	free(next);
+	free(previous);
+	free(lengths);
+
+	return status;
+}
+
+int blocks_count(FILE *input, long start, long length, codec_t *codec,
+		 blocks_t *blocks, frequency_table_t total)
+{
+	blocks->blocks = NULL;
+	blocks->count = 0;
+	blocks->size = 0;
+
+	long unsigned int chunk_size = blocks_chunk_size(length);
+	unsigned int count = (length + chunk_size - 1) / chunk_size;
+	frequency_t *chunks = calloc(count, BLOCKS_TABLE_SIZE);
+	if (NULL == chunks)
+		return -1;
+
+	// As many threads as histogram_count() would use
+	int threads = memory_plan()->threads;
+	if (length / threads < HISTOGRAM_PARALLEL_MIN)
+		threads = length / HISTOGRAM_PARALLEL_MIN;
+	if (threads < 1)
+		threads = 1;
+
+	int status = histogram_count_chunks(fileno(input), start,
+					    start + length, chunk_size,
+					    threads, chunks);
+	if (0 != status)
+		goto finalize;
+
+	for (unsigned int i = 0; i < count; i++) {
+		for (int j = 0; j < HUFFMAN_MAX_SYMBOLS; j++) {
+			total[j] += chunks[i * HUFFMAN_MAX_SYMBOLS + j];
+		}
+	}
+
+	status = blocks_split(chunks, count, chunk_size, length,
+			      blocks_budget(length), blocks);
+	if (0 != status || blocks->count < 2)
+		goto finalize;
+
+	// The estimates chose the boundaries, the actual codes decide: the
+	// blocks are kept only when they are smaller than a single table
+	long unsigned int split = HUFFMAN_MAGIC_SIZE + HUFFMAN_FILE_LENGTH_SIZE
+	    + sizeof(blocks->count);
+	for (unsigned int i = 0; i < blocks->count; i++) {
+		block_t *block = &blocks->blocks[i];
+		codec_prepare(codec, block->table);
+		block->size = __blocks_table_size(block->table) +
+		    codec_coded_size(codec, block->table);
+		split += BLOCKS_ENTRY_SIZE + block->size;
+	}
+
+	codec_prepare(codec, total);
+	long unsigned int single = HUFFMAN_MAGIC_SIZE +
+	    HUFFMAN_FILE_LENGTH_SIZE + __blocks_table_size(total) +
+	    codec_coded_size(codec, total);
+	blocks->size = split;
+	if (split >= single)
+		blocks_destroy(blocks);
+
+ finalize:;
+	free(chunks);
+
+	return status;
+}
+
+// Writes `table` to `output` at once
+int __blocks_write_table(output_t *output, const frequency_t *table)
+{
+	char *bytes = NULL;
+	size_t size = 0;
+	FILE *stream = open_memstream(&bytes, &size);
+	if (NULL == stream)
+		return -1;
+
+	int status = __write_frequencies(stream, (frequency_t *) table);
+	if (0 != fclose(stream))
+		status = -1;
+
+	if (0 == status)
+		status = output_write(output, (unsigned char *)bytes, size);
+	free(bytes);
+
+	return status;
+}
+
+int __blocks_write_header(output_t *output, const blocks_t *blocks,
+			  long unsigned int *size)
+{
+	long unsigned int file_length = 0;
+	for (unsigned int i = 0; i < blocks->count; i++) {
+		file_length += blocks->blocks[i].length;
+	}
+
+	char *header = NULL;
+	size_t header_size = 0;
+	FILE *stream = open_memstream(&header, &header_size);
+	if (NULL == stream)
+		return -1;
+
+	// "HUFB" magic number, length of original file, then the blocks
+	fwrite(HUFFMAN_BLOCKS_MAGIC, sizeof(char), HUFFMAN_MAGIC_SIZE, stream);
+	fwrite(&file_length, sizeof(file_length), 1, stream);
+	fwrite(&blocks->count, sizeof(blocks->count), 1, stream);
+	*size = 0;
+	for (unsigned int i = 0; i < blocks->count; i++) {
+		fwrite(&blocks->blocks[i].length,
+		       sizeof(blocks->blocks[i].length), 1, stream);
+		fwrite(&blocks->blocks[i].size,
+		       sizeof(blocks->blocks[i].size), 1, stream);
+		*size += blocks->blocks[i].size;
+	}
+
+	int status = ferror(stream) ? -1 : 0;
+	if (0 != fclose(stream))
+		status = -1;
+
+	if (0 == status)
+		status = output_write(output, (unsigned char *)header,
+				      header_size);
+	*size += header_size;
+	free(header);
+
+	return status;
+}
+
+int blocks_encode(FILE *input, output_t *output, long start,
+		  const blocks_t *blocks, codec_t *codec)
+{
+	long unsigned int size = 0;
+	if (0 != __blocks_write_header(output, blocks, &size)
+	    || 0 != output_reserve(output, size)
+	    || 0 != fseek(input, start, SEEK_SET))
+		return -1;
+
+	size_t capacity = memory_plan()->buffer_size;
+	unsigned char *buffer = malloc(capacity);
+	bit_writer_t writer;
+	if (NULL == buffer)
+		return -1;
+	if (0 != bit_writer_create_output(&writer, output)) {
+		free(buffer);
+		return -1;
+	}
+
+	// One pass over the input: each block starts with its table, and its
+	// codes end on a byte
+	int status = 0;
+	size_t position = 0, available = 0;
+	for (unsigned int i = 0; 0 == status && i < blocks->count; i++) {
+		const block_t *block = &blocks->blocks[i];
+		frequency_t *table = (frequency_t *) block->table;
+		if (0 != __blocks_write_table(output, table)
+		    || 0 != codec_prepare(codec, table)) {
+			status = -1;
+			break;
+		}
+		codec_prepare_encoder(codec, block->length);
+
+		for (long unsigned int remaining = block->length;
+		     remaining > 0 && !writer.failed;) {
+			if (0 == available) {
+				available = fread(buffer, 1, capacity, input);
+				position = 0;
+				if (0 == available) {
+					status = -1;
+					break;
+				}
+			}
+
+			size_t length = available < remaining ? available :
+			    remaining;
+			__encode_buffer(&writer, codec, buffer + position,
+					length);
+			position += length;
+			available -= length;
+			remaining -= length;
+		}
+
+		if (0 != bit_writer_flush(&writer))
+			status = -1;
+	}
+
+	bit_writer_destroy(&writer);
+	free(buffer);
+
+	return status;
+}
+
+int blocks_decode(FILE *file, output_t *output,
+		  const stream_header_t *header, codec_t *codec)
+{
+	long unsigned int offset = header->block_list +
+	    header->block_count * BLOCKS_ENTRY_SIZE;
+	long unsigned int decoded = 0;
+
+	for (unsigned int i = 0; i < header->block_count; i++) {
+		long unsigned int length = 0, size = 0;
+		if (0 != fseek(file, header->block_list + i * BLOCKS_ENTRY_SIZE,
+			       SEEK_SET)
+		    || fread(&length, sizeof(length), 1, file) != 1
+		    || fread(&size, sizeof(size), 1, file) != 1
+		    || 0 == length || length > header->file_length - decoded
+		    || 0 != fseek(file, offset, SEEK_SET))
+			return -1;
+
+		// Each block is a stream of its own, without the magic and
+		// length
+		stream_header_t block = {.file_length = length,
+			.symbol_length = length,.filters = TRANSFORM_NONE
+		};
+		frequency_table_t frequency_table = NULL;
+		int status = __read_frequencies(file, &block.symbol_count,
+						&frequency_table);
+		if (0 == status)
+			status = codec_prepare(codec, frequency_table);
+		if (0 == status)
+			status = __write_stream(file, output, &block, codec);
+		frequencies_destroy(&frequency_table);
+		if (0 != status)
+			return -1;
+
+		offset += size;
+		decoded += length;
+	}
+
+	return decoded == header->file_length ? 0 : -1;
+}
+
+void blocks_destroy(blocks_t *blocks)
+{
+	free(blocks->blocks);
+	blocks->blocks = NULL;
+	blocks->count = 0;
+	blocks->size = 0;
+}
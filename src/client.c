@@ -0,0 +1,59 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "huffman/server.h"
+
+int client_connect(const char *path)
+{
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path))
+		return -1;
+	strcpy(address.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	if (0 != connect(fd, (struct sockaddr *)&address, sizeof(address))) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int client_request(int fd, server_operation_t operation,
+		   const unsigned char *payload, size_t length,
+		   unsigned char **response, size_t *response_length)
+{
+	server_request_t request = {.operation = operation,.flags = 0,
+		.length = length
+	};
+
+	if (0 != __server_write(fd, &request, sizeof(request))
+	    || 0 != __server_write(fd, payload, length))
+		return -1;
+
+	server_response_t header;
+	if (0 != __server_read(fd, &header, sizeof(header)))
+		return -1;
+
+	unsigned char *body = realloc(*response, header.length + 1);
+	if (NULL == body)
+		return -1;
+	*response = body;
+	*response_length = header.length;
+
+	if (header.length > 0 && 0 != __server_read(fd, body, header.length))
+		return -1;
+	body[header.length] = '\0';
+
+	return header.status;
+}
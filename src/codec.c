@@ -0,0 +1,657 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "huffman/bitstream.h"
+#include "huffman/blocks.h"
+#include "huffman/codec.h"
+#include "huffman/encoding_table.h"
+#include "huffman/histogram.h"
+#include "huffman/huffman.h"
+#include "huffman/huffman_tree.h"
+#include "huffman/memory.h"
+#include "huffman/output.h"
+#include "huffman/plan.h"
+#include "huffman/statistics.h"
+#include "huffman/transform.h"
+#include "types/queue.h"
+
+queue build_queue(frequency_table_t table)
+{
+	queue queue =
+	    queue_create(FLAG_SORTED, huffman_tree_copy, huffman_tree_free,
+			 huffman_tree_compare);
+
+	for (int i = 0; i < 256; i++) {
+		statistic_t statistic = {.symbol = i,.count =
+			    frequencies_get(table, i)
+		};
+		if (0 == statistic.count)
+			continue;
+
+		huffman_tree_t huffman_tree = huffman_tree_create(&statistic);
+		queue_enqueue(&queue, &huffman_tree);
+		huffman_tree_destroy(&huffman_tree);
+	}
+
+	return queue;
+}
+
+huffman_tree_t *build_huffman_tree(queue *queue)
+{
+	long length = queue_length(*queue);
+	while (length >= 2) {
+		huffman_tree_t *left = queue_dequeue(queue);
+		huffman_tree_t *right = queue_dequeue(queue);
+
+		statistic_t *left_statistic = huffman_tree_get_data(*left);
+		statistic_t *right_statistic = huffman_tree_get_data(*right);
+
+		statistic_t statistic = {.symbol = 0,.count =
+			    left_statistic->count + right_statistic->count
+		};
+
+		huffman_tree_t huffman_tree = huffman_tree_create(&statistic);
+		statistic_t *huffman_statistic =
+		    huffman_tree_get_data(huffman_tree);
+		huffman_tree_set_left(huffman_tree, *left);
+		huffman_tree_set_right(huffman_tree, *right);
+
+		queue_enqueue(queue, &huffman_tree);
+		free(huffman_tree);
+		free(huffman_statistic);
+		free(left);
+		free(right);
+		length--;
+	}
+
+	return queue_dequeue(queue);
+}
+
+void build_encoding_table_recursive(const huffman_tree_t huffman_tree,
+				    encoding_table_t encoding_table,
+				    encoding_t *encoding)
+{
+	if (NULL == huffman_tree || binary_tree_is_leaf(huffman_tree)) {
+		if (encoding_length(*encoding) < 1) {
+			encoding_set(encoding, 0, 1);
+		}
+
+		encoding_table[huffman_tree_get_data(huffman_tree)->symbol] =
+		    *encoding;
+		return;
+	}
+
+	encoding_t encodingLeft = encoding_copy(*encoding);
+	encoding_t encodingRight = encoding_copy(*encoding);
+	encoding_destroy(encoding);
+
+	if (huffman_tree_get_left(huffman_tree) != NULL) {
+		encoding_set(&encodingLeft, encoding_length(encodingLeft), 0);
+		build_encoding_table_recursive(huffman_tree_get_left
+					       (huffman_tree), encoding_table,
+					       &encodingLeft);
+	}
+
+	if (huffman_tree_get_right(huffman_tree) != NULL) {
+		encoding_set(&encodingRight, encoding_length(encodingRight), 1);
+		build_encoding_table_recursive(huffman_tree_get_right
+					       (huffman_tree), encoding_table,
+					       &encodingRight);
+	}
+}
+
+int build_encoding_table(const huffman_tree_t huffman_tree,
+			 encoding_table_t table)
+{
+	encoding_t encoding = encoding_create();
+	build_encoding_table_recursive(huffman_tree, table, &encoding);
+
+	return 0;
+}
+
+void build_decoding_table(const huffman_tree_t huffman_tree,
+			  decoding_t *table)
+{
+	for (int i = 0; i < DECODING_TABLE_SIZE; i++) {
+		huffman_tree_t current = huffman_tree;
+		int length = 0;
+
+		while (length < DECODING_TABLE_BITS
+		       && !binary_tree_is_leaf(current)) {
+			if ((i >> (DECODING_TABLE_BITS - 1 - length)) & 0x1)
+				current = huffman_tree_get_right(current);
+			else
+				current = huffman_tree_get_left(current);
+			length++;
+		}
+
+		if (binary_tree_is_leaf(current)) {
+			table[i] = (decoding_t) {
+				.node = NULL,.symbol =
+				    huffman_tree_get_data(current)->symbol,
+				.length = length
+			};
+		} else {
+			table[i] = (decoding_t) {
+				.node = current,.symbol = 0,.length = length
+			};
+		}
+	}
+}
+
+void codec_create(codec_t *codec)
+{
+	memset(codec, 0, sizeof(*codec));
+}
+
+void __codec_clear(codec_t *codec)
+{
+	huffman_tree_free(codec->huffman_tree);
+	codec->huffman_tree = NULL;
+
+	for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++) {
+		if (NULL != codec->encoding_table[i].code)
+			encoding_destroy(&codec->encoding_table[i]);
+	}
+	memset(codec->packed_table, 0, sizeof(codec->packed_table));
+	free(codec->pair_table);
+	codec->pair_table = NULL;
+
+	free(codec->decoding_table);
+	codec->decoding_table = NULL;
+	codec->ready = false;
+}
+
+int codec_prepare(codec_t *codec, frequency_table_t table)
+{
+	if (codec->ready
+	    && 0 == memcmp(codec->frequencies, table,
+			   sizeof(codec->frequencies)))
+		return 0;
+
+	__codec_clear(codec);
+	memcpy(codec->frequencies, table, sizeof(codec->frequencies));
+
+	queue queue = build_queue(table);
+	codec->huffman_tree = build_huffman_tree(&queue);
+	queue_destroy(&queue);
+
+	if (NULL != codec->huffman_tree) {
+		build_encoding_table(*codec->huffman_tree,
+				     codec->encoding_table);
+		encoding_table_pack(codec->encoding_table, codec->packed_table,
+				    BITSTREAM_MAX_BITS);
+	}
+
+	codec->ready = true;
+	return 0;
+}
+
+int codec_prepare_pairs(codec_t *codec)
+{
+	if (NULL != codec->pair_table)
+		return 0;
+
+	if (!codec->ready || NULL == codec->huffman_tree)
+		return -1;
+
+	codec->pair_table =
+	    malloc(ENCODING_PAIR_TABLE_SIZE * sizeof(pair_encoding_t));
+	if (NULL == codec->pair_table)
+		return -1;
+
+	encoding_table_pair(codec->packed_table, codec->pair_table,
+			    BITSTREAM_MAX_BITS);
+	return 0;
+}
+
+void codec_prepare_encoder(codec_t *codec, long unsigned int length)
+{
+	// Without the pair table, the encoder falls back to single symbols
+	const memory_plan_t *plan = memory_plan();
+	if (length >= CODEC_PAIR_THRESHOLD
+	    && (0 == plan->limit || plan->limit >= CODEC_PAIR_MEMORY))
+		codec_prepare_pairs(codec);
+}
+
+long unsigned int codec_coded_size(const codec_t *codec,
+				   const frequency_t *table)
+{
+	long unsigned int bits = 0;
+	for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++) {
+		if (0 != table[i])
+			bits += table[i] *
+			    encoding_length(codec->encoding_table[i]);
+	}
+
+	return (bits + 7) / 8;
+}
+
+void codec_destroy(codec_t *codec)
+{
+	__codec_clear(codec);
+}
+
+decoding_t *__codec_decoding_table(codec_t *codec)
+{
+	if (NULL != codec->decoding_table)
+		return codec->decoding_table;
+
+	codec->decoding_table =
+	    malloc(DECODING_TABLE_SIZE * sizeof(decoding_t));
+	if (NULL != codec->decoding_table)
+		build_decoding_table(*codec->huffman_tree,
+				     codec->decoding_table);
+
+	return codec->decoding_table;
+}
+
+int __write_frequencies(FILE *output, frequency_table_t frequency_table)
+{
+	// Number of symbols
+	unsigned int symbol_count = 0;
+	for (int i = 0; i < 256; i++) {
+		if (0 != frequency_table[i]) {
+			symbol_count++;
+		}
+	}
+	--symbol_count;
+	fwrite(&symbol_count, sizeof(char), 1, output);
+	// Frequencies
+	for (int i = 0; i < 256; i++) {
+		if (0 != frequency_table[i]) {
+			fwrite(&i, sizeof(char), 1, output);
+			fwrite(&frequency_table[i], sizeof(frequency_table[i]),
+			       1, output);
+		}
+	}
+
+	return ferror(output) ? -1 : 0;
+}
+
+int write_header(FILE *output, long unsigned int file_length,
+		 frequency_table_t frequency_table)
+{
+	// "HUFF" magic number
+	fwrite(HUFFMAN_MAGIC, sizeof(char), HUFFMAN_MAGIC_SIZE, output);
+	// Length of original file
+	fwrite(&file_length, sizeof(file_length), 1, output);
+
+	if (0 == file_length || NULL == frequency_table)
+		return ferror(output) ? -1 : 0;
+
+	return __write_frequencies(output, frequency_table);
+}
+
+int write_transform_header(FILE *output, long unsigned int file_length,
+			   unsigned char filters,
+			   frequency_table_t frequency_table)
+{
+	// "HUFT" magic number
+	fwrite(HUFFMAN_TRANSFORM_MAGIC, sizeof(char), HUFFMAN_MAGIC_SIZE,
+	       output);
+	// Length of original file
+	fwrite(&file_length, sizeof(file_length), 1, output);
+	// Filters, and number of symbols they produced
+	fwrite(&filters, sizeof(filters), 1, output);
+	long unsigned int symbol_length = 0;
+	for (int i = 0; i < 256; i++) {
+		symbol_length += frequency_table[i];
+	}
+	fwrite(&symbol_length, sizeof(symbol_length), 1, output);
+
+	return __write_frequencies(output, frequency_table);
+}
+
+int __read_frequencies(FILE *file, unsigned int *symbol_count,
+		       frequency_table_t *frequency_table)
+{
+	if (fread(symbol_count, sizeof(char), 1, file) != 1)
+		return -1;
+	(*symbol_count)++;
+
+	frequencies_create(frequency_table);
+	for (int i = 0; i < *symbol_count; i++) {
+		unsigned char symbol = 0;
+		long unsigned int frequency = 0;
+		if (fread(&symbol, sizeof(symbol), 1, file) != 1)
+			return -1;
+		if (fread(&frequency, sizeof(frequency), 1, file) != 1)
+			return -1;
+		frequencies_set(*frequency_table, symbol, frequency);
+	}
+
+	return 0;
+}
+
+int read_compressed_file(FILE *file, stream_header_t *header,
+			 frequency_table_t *frequency_table)
+{
+	char magic[HUFFMAN_MAGIC_SIZE];
+	if (fread(magic, sizeof(char), HUFFMAN_MAGIC_SIZE, file) !=
+	    HUFFMAN_MAGIC_SIZE)
+		return -1;
+
+	bool transformed =
+	    0 == strncmp(magic, HUFFMAN_TRANSFORM_MAGIC, HUFFMAN_MAGIC_SIZE);
+	bool split =
+	    0 == strncmp(magic, HUFFMAN_BLOCKS_MAGIC, HUFFMAN_MAGIC_SIZE);
+	if (!transformed && !split
+	    && 0 != strncmp(magic, HUFFMAN_MAGIC, HUFFMAN_MAGIC_SIZE))
+		return -1;
+
+	if (fread(&header->file_length, sizeof(header->file_length), 1, file)
+	    != 1)
+		return -1;
+
+	header->filters = TRANSFORM_NONE;
+	header->symbol_length = header->file_length;
+	header->symbol_count = 0;
+	header->block_count = 0;
+	header->block_list = 0;
+	if (split) {
+		if (fread(&header->block_count, sizeof(header->block_count), 1,
+			  file) != 1 || 0 == header->block_count)
+			return -1;
+		long block_list = ftell(file);
+		if (block_list < 0
+		    || 0 != fseek(file,
+				  header->block_count * BLOCKS_ENTRY_SIZE,
+				  SEEK_CUR))
+			return -1;
+		header->block_list = block_list;
+	}
+	if (transformed) {
+		if (fread(&header->filters, sizeof(header->filters), 1, file)
+		    != 1
+		    || fread(&header->symbol_length,
+			     sizeof(header->symbol_length), 1, file) != 1)
+			return -1;
+		if (header->filters & ~TRANSFORM_ALL
+		    || header->symbol_length >
+		    transform_bound(header->file_length))
+			return -1;
+	}
+
+	if (0 == header->file_length)
+		return 0;
+
+	return __read_frequencies(file, &header->symbol_count,
+				  frequency_table);
+}
+
+static inline void __encode_symbol(bit_writer_t *writer, codec_t *codec,
+				   symbol_t symbol)
+{
+	packed_encoding_t packed = codec->packed_table[symbol];
+	if (packed.length > 0) {
+		bit_writer_put(writer, packed.bits, packed.length);
+		return;
+	}
+	// Codes longer than a word are written bit by bit
+	encoding_t encoding = codec->encoding_table[symbol];
+	for (int j = 0; j < encoding_length(encoding); j++) {
+		bit_writer_put(writer, encoding_get(encoding, j), 1);
+	}
+}
+
+void __encode_buffer(bit_writer_t *writer, codec_t *codec,
+		     const unsigned char *buffer, size_t length)
+{
+	const pair_encoding_t *pairs = codec->pair_table;
+	size_t i = 0;
+	// Two symbols per lookup, when the pair table is built
+	if (NULL != pairs) {
+		for (; i + 1 < length; i += 2) {
+			pair_encoding_t pair =
+			    pairs[(buffer[i] << 8) | buffer[i + 1]];
+			if (0 != pair) {
+				bit_writer_put(writer, PAIR_ENCODING_BITS(pair),
+					       PAIR_ENCODING_LENGTH(pair));
+				continue;
+			}
+			__encode_symbol(writer, codec, buffer[i]);
+			__encode_symbol(writer, codec, buffer[i + 1]);
+		}
+	}
+
+	for (; i < length; i++) {
+		__encode_symbol(writer, codec, buffer[i]);
+	}
+}
+
+int encode_file(FILE *input, FILE *output, unsigned char filters,
+		codec_t *codec)
+{
+	long start = ftell(input);
+	if (start < 0 || 0 != fseek(input, 0, SEEK_END))
+		return -1;
+	long end = ftell(input);
+	if (end < 0 || 0 != fseek(input, start, SEEK_SET))
+		return -1;
+
+	output_t stream;
+	output_open_stream(&stream, output);
+	return encode_output(input, end - start, &stream, filters, codec);
+}
+
+int encode_output(FILE *input, long unsigned int length, output_t *output,
+		  unsigned char filters, codec_t *codec)
+{
+	transform_reader_t transform_reader;
+	if (0 != transform_reader_create(&transform_reader, input, length,
+					 filters, memory_plan()->buffer_size))
+		return -1;
+
+	bit_writer_t writer;
+	if (0 != bit_writer_create_output(&writer, output)) {
+		transform_reader_destroy(&transform_reader);
+		return -1;
+	}
+
+	const unsigned char *buffer;
+	size_t count;
+	// A failed write stops the encoding, and fails the flush
+	while (!writer.failed
+	       && (count = transform_reader_read(&transform_reader,
+						 &buffer)) > 0) {
+		__encode_buffer(&writer, codec, buffer, count);
+	}
+
+	// A file that shrank leaves the stream short of its header length
+	int status = bit_writer_flush(&writer);
+	if (0 != transform_reader.remaining || ferror(input))
+		status = -1;
+	bit_writer_destroy(&writer);
+	transform_reader_destroy(&transform_reader);
+
+	return status;
+}
+
+// Writes one decoded symbol, through the inverse filters if any
+static inline void __write_symbol(output_t *output, transform_t *transform,
+				  symbol_t symbol)
+{
+	if (TRANSFORM_NONE == transform->filters)
+		output_put(output, symbol);
+	else
+		transform_inverse_put(transform, output, symbol);
+}
+
+int write_file(FILE *file, output_t *output, const stream_header_t *header,
+	       codec_t *codec)
+{
+	if (0 == header->file_length)
+		return 0;
+
+	if (header->block_count > 0)
+		return blocks_decode(file, output, header, codec);
+
+	return __write_stream(file, output, header, codec);
+}
+
+int __write_stream(FILE *file, output_t *output,
+		   const stream_header_t *header, codec_t *codec)
+{
+	if (NULL == codec->huffman_tree)
+		return -1;
+
+	// The output may already hold the streams decoded before this one
+	size_t start = output->position;
+	transform_t transform;
+	transform_create(&transform, header->filters);
+
+	// A single symbol is coded on one bit per occurrence: nothing to read
+	huffman_tree_t root = *codec->huffman_tree;
+	if (binary_tree_is_leaf(root)) {
+		symbol_t symbol = huffman_tree_get_data(root)->symbol;
+		for (long unsigned int i = 0; i < header->symbol_length; i++) {
+			__write_symbol(output, &transform, symbol);
+		}
+		return output->position - start == header->file_length ? 0 : -1;
+	}
+
+	decoding_t *table = __codec_decoding_table(codec);
+	bit_reader_t reader;
+	if (NULL == table || 0 != bit_reader_create(&reader, file))
+		return -1;
+
+	for (long unsigned int length = 0; length < header->symbol_length;
+	     length++) {
+		decoding_t decoding =
+		    table[bit_reader_peek(&reader, DECODING_TABLE_BITS)];
+		bit_reader_consume(&reader, decoding.length);
+
+		huffman_tree_t current = decoding.node;
+		if (NULL == current) {
+			__write_symbol(output, &transform, decoding.symbol);
+			continue;
+		}
+
+		while (!binary_tree_is_leaf(current)) {
+			if (bit_reader_read(&reader, 1))
+				current = huffman_tree_get_right(current);
+			else
+				current = huffman_tree_get_left(current);
+		}
+		__write_symbol(output, &transform,
+			       huffman_tree_get_data(current)->symbol);
+	}
+
+	bit_reader_destroy(&reader);
+
+	return output->position - start == header->file_length ? 0 : -1;
+}
+
+int __histogram_transformed(FILE *input, long unsigned int length,
+			    unsigned char filters, frequency_table_t table)
+{
+	transform_reader_t transform_reader;
+	if (0 != transform_reader_create(&transform_reader, input, length,
+					 filters, memory_plan()->buffer_size))
+		return -1;
+
+	const unsigned char *buffer;
+	size_t count;
+	while ((count =
+		transform_reader_read(&transform_reader, &buffer)) > 0) {
+		histogram_count_buffer(buffer, count, table);
+	}
+
+	int status = ferror(input) || 0 != transform_reader.remaining ?
+	    -1 : 0;
+	transform_reader_destroy(&transform_reader);
+
+	return status;
+}
+
+int compress_stream(FILE *input, FILE *output, compression_level_t level,
+		    unsigned char filters, codec_t *codec)
+{
+	output_t stream;
+	output_open_stream(&stream, output);
+	return compress_output(input, &stream, level, filters, codec);
+}
+
+// Writes the header of a stream to `output` at once
+int __compress_header(output_t *output, long unsigned int file_length,
+		      unsigned char filters,
+		      frequency_table_t frequency_table, size_t *size)
+{
+	char *header = NULL;
+	FILE *stream = open_memstream(&header, size);
+	if (NULL == stream)
+		return -1;
+
+	int status = TRANSFORM_NONE == filters ?
+	    write_header(stream, file_length, frequency_table) :
+	    write_transform_header(stream, file_length, filters,
+				   frequency_table);
+	if (0 != fclose(stream))
+		status = -1;
+
+	if (0 == status)
+		status = output_write(output, (unsigned char *)header, *size);
+	free(header);
+
+	return status;
+}
+
+int compress_output(FILE *input, output_t *output, compression_level_t level,
+		    unsigned char filters, codec_t *codec)
+{
+	return compress_range(input, output, 0, level, filters, codec);
+}
+
+// Compresses `input` from `start` to its end
+int compress_range(FILE *input, output_t *output, long start,
+		   compression_level_t level, unsigned char filters,
+		   codec_t *codec)
+{
+	compress_plan_t plan;
+	if (0 != compress_plan(input, start, level, filters, codec, &plan))
+		return -1;
+	memory_phase_end("count");
+
+	int status = compress_planned(input, output, start, &plan, codec);
+	compress_plan_destroy(&plan);
+
+	return status;
+}
+
+// Encodes what compress_plan planned, with the codec it prepared
+int compress_planned(FILE *input, output_t *output, long start,
+		     const compress_plan_t *plan, codec_t *codec)
+{
+	if (plan->blocks.count > 1) {
+		int status = blocks_encode(input, output, start, &plan->blocks,
+					   codec);
+		memory_phase_end("encode");
+		return status;
+	}
+
+	size_t header_size = 0;
+	if (0 != __compress_header(output, plan->length, plan->filters,
+				   plan->frequency_table, &header_size))
+		return -1;
+	if (0 == plan->length)
+		return 0;
+
+	codec_prepare_encoder(codec, plan->length);
+	memory_phase_end("tables");
+
+	// The plan gives the size of the output: exact, or estimated when
+	// the counts were sampled
+	if (0 != output_reserve(output, plan->size))
+		return -1;
+
+	int status = encode_output(input, plan->length, output, plan->filters,
+				   codec);
+	memory_phase_end("encode");
+
+	return status;
+}
@@ -0,0 +1,106 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "huffman/dispatch.h"
+
+static const char *cpu_variant_names[CPU_VARIANT_COUNT] = {
+	"scalar", "sse4.2", "avx2", "avx512"
+};
+
+static bool dispatch_initialized = false;
+static cpu_variant_t dispatch_current = CPU_VARIANT_SCALAR;
+
+const char *cpu_variant_name(cpu_variant_t variant)
+{
+	if (variant >= CPU_VARIANT_COUNT)
+		return "unknown";
+
+	return cpu_variant_names[variant];
+}
+
+int cpu_variant_parse(const char *name, cpu_variant_t *variant)
+{
+	for (int i = 0; i < CPU_VARIANT_COUNT; i++) {
+		if (0 == strcmp(name, cpu_variant_names[i])) {
+			*variant = i;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+bool cpu_variant_supported(cpu_variant_t variant)
+{
+	if (CPU_VARIANT_SCALAR == variant)
+		return true;
+
+#if DISPATCH_X86
+	__builtin_cpu_init();
+
+	switch (variant) {
+	case CPU_VARIANT_SSE42:
+		return __builtin_cpu_supports("sse4.2");
+	case CPU_VARIANT_AVX2:
+		return __builtin_cpu_supports("avx2");
+	case CPU_VARIANT_AVX512:
+		return __builtin_cpu_supports("avx512f")
+		    && __builtin_cpu_supports("avx512bw");
+	default:
+		return false;
+	}
+#else
+	return false;
+#endif
+}
+
+cpu_variant_t cpu_variant_best(void)
+{
+	for (int i = CPU_VARIANT_COUNT - 1; i > CPU_VARIANT_SCALAR; i--) {
+		if (cpu_variant_supported(i))
+			return i;
+	}
+
+	return CPU_VARIANT_SCALAR;
+}
+
+int dispatch_select(cpu_variant_t variant)
+{
+	if (variant >= CPU_VARIANT_COUNT || !cpu_variant_supported(variant))
+		return -1;
+
+	dispatch_current = variant;
+	dispatch_initialized = true;
+
+	return 0;
+}
+
+cpu_variant_t dispatch_variant(void)
+{
+	if (dispatch_initialized)
+		return dispatch_current;
+
+	cpu_variant_t variant = cpu_variant_best();
+
+	const char *forced = getenv(DISPATCH_ENVIRONMENT);
+	if (NULL != forced && '\0' != forced[0]) {
+		cpu_variant_t requested;
+		if (0 != cpu_variant_parse(forced, &requested)) {
+			fprintf(stderr, "Unknown %s variant: %s\n",
+				DISPATCH_ENVIRONMENT, forced);
+		} else if (!cpu_variant_supported(requested)) {
+			fprintf(stderr,
+				"%s variant not supported by this CPU: %s\n",
+				DISPATCH_ENVIRONMENT, forced);
+		} else {
+			variant = requested;
+		}
+	}
+
+	dispatch_current = variant;
+	dispatch_initialized = true;
+
+	return dispatch_current;
+}
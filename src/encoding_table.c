@@ -121,3 +121,46 @@ bool encoding_compare(encoding_t a, encoding_t b)
 
 	return true;
 }
+
+packed_encoding_t encoding_pack(encoding_t code, int max_length)
+{
+	packed_encoding_t packed = {.bits = 0,.length = 0 };
+
+	if (NULL == code.code || encoding_length(code) > max_length)
+		return packed;
+
+	for (int i = 0; i < encoding_length(code); i++) {
+		packed.bits = (packed.bits << 1) | encoding_get(code, i);
+	}
+	packed.length = encoding_length(code);
+
+	return packed;
+}
+
+void encoding_table_pack(encoding_table_t table,
+			 packed_encoding_table_t packed, int max_length)
+{
+	for (int i = 0; i < 256; i++) {
+		packed[i] = encoding_pack(table[i], max_length);
+	}
+}
+
+void encoding_table_pair(const packed_encoding_t *packed,
+			 pair_encoding_t *pairs, int max_length)
+{
+	for (int i = 0; i < 256; i++) {
+		for (int j = 0; j < 256; j++) {
+			unsigned int length = packed[i].length +
+			    packed[j].length;
+			if (0 == packed[i].length || 0 == packed[j].length
+			    || length > (unsigned int)max_length) {
+				pairs[(i << 8) | j] = 0;
+				continue;
+			}
+
+			uint64_t bits = (packed[i].bits << packed[j].length)
+			    | packed[j].bits;
+			pairs[(i << 8) | j] = (bits << 8) | length;
+		}
+	}
+}
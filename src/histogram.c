@@ -0,0 +1,481 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "huffman/dispatch.h"
+#include "huffman/histogram.h"
+#include "huffman/huffman.h"
+#include "huffman/memory.h"
+#include "huffman/statistics.h"
+
+#if DISPATCH_X86
+#include <immintrin.h>
+#endif
+
+int compression_level_parse(const char *name, compression_level_t *level)
+{
+	if (0 == strcmp(name, "fast") || 0 == strcmp(name, "1")) {
+		*level = COMPRESSION_LEVEL_FAST;
+		return 0;
+	}
+
+	if (0 == strcmp(name, "normal") || 0 == strcmp(name, "9")) {
+		*level = COMPRESSION_LEVEL_NORMAL;
+		return 0;
+	}
+
+	return -1;
+}
+
+// Counts eight bytes of one load into eight interleaved partial tables,
+// so that runs of the same byte do not serialize on a single counter
+static inline __attribute__((always_inline))
+void __histogram_count_word(uint32_t counts[8][HUFFMAN_MAX_SYMBOLS],
+			    const unsigned char *buffer)
+{
+	uint64_t word;
+	memcpy(&word, buffer, sizeof(word));
+	counts[0][word & 0xFF]++;
+	counts[1][(word >> 8) & 0xFF]++;
+	counts[2][(word >> 16) & 0xFF]++;
+	counts[3][(word >> 24) & 0xFF]++;
+	counts[4][(word >> 32) & 0xFF]++;
+	counts[5][(word >> 40) & 0xFF]++;
+	counts[6][(word >> 48) & 0xFF]++;
+	counts[7][word >> 56]++;
+}
+
+// Counts what a kernel left past its last whole vector, then adds the
+// partial tables to `table`
+static inline __attribute__((always_inline))
+void __histogram_count_merge(uint32_t counts[8][HUFFMAN_MAX_SYMBOLS],
+			     const unsigned char *buffer, size_t i,
+			     size_t slab, frequency_table_t table)
+{
+	for (; i + 8 <= slab; i += 8) {
+		__histogram_count_word(counts, buffer + i);
+	}
+	for (; i < slab; i++) {
+		counts[0][buffer[i]]++;
+	}
+
+	for (int s = 0; s < HUFFMAN_MAX_SYMBOLS; s++) {
+		frequency_t count = 0;
+		for (int k = 0; k < 8; k++) {
+			count += counts[k][s];
+		}
+		table[s] += count;
+	}
+}
+
+void __histogram_count_scalar(const unsigned char *buffer, size_t length,
+			      frequency_table_t table)
+{
+	uint32_t counts[8][HUFFMAN_MAX_SYMBOLS];
+
+	while (length > 0) {
+		size_t slab = length < HISTOGRAM_SLAB_SIZE ?
+		    length : HISTOGRAM_SLAB_SIZE;
+		memset(counts, 0, sizeof(counts));
+		__histogram_count_merge(counts, buffer, 0, slab, table);
+
+		buffer += slab;
+		length -= slab;
+	}
+}
+
+// The vector kernels compare each vector with its first byte: a vector
+// of a single byte value, as in runs and padding, is counted with one
+// addition, any other one word by word into the partial tables.
+#if DISPATCH_X86
+__attribute__((target("sse4.2")))
+void __histogram_count_sse42(const unsigned char *buffer, size_t length,
+			     frequency_table_t table)
+{
+	uint32_t counts[8][HUFFMAN_MAX_SYMBOLS];
+
+	while (length > 0) {
+		size_t slab = length < HISTOGRAM_SLAB_SIZE ?
+		    length : HISTOGRAM_SLAB_SIZE;
+		memset(counts, 0, sizeof(counts));
+
+		size_t i = 0;
+		for (; i + 16 <= slab; i += 16) {
+			__m128i vector =
+			    _mm_loadu_si128((const __m128i *)(buffer + i));
+			__m128i equal = _mm_cmpeq_epi8(vector,
+						       _mm_set1_epi8(buffer
+								     [i]));
+			if (_mm_test_all_ones(equal)) {
+				counts[0][buffer[i]] += 16;
+			} else {
+				__histogram_count_word(counts, buffer + i);
+				__histogram_count_word(counts, buffer + i + 8);
+			}
+		}
+		__histogram_count_merge(counts, buffer, i, slab, table);
+
+		buffer += slab;
+		length -= slab;
+	}
+}
+
+__attribute__((target("avx2")))
+void __histogram_count_avx2(const unsigned char *buffer, size_t length,
+			    frequency_table_t table)
+{
+	uint32_t counts[8][HUFFMAN_MAX_SYMBOLS];
+
+	while (length > 0) {
+		size_t slab = length < HISTOGRAM_SLAB_SIZE ?
+		    length : HISTOGRAM_SLAB_SIZE;
+		memset(counts, 0, sizeof(counts));
+
+		size_t i = 0;
+		for (; i + 32 <= slab; i += 32) {
+			__m256i vector =
+			    _mm256_loadu_si256((const __m256i *)(buffer + i));
+			__m256i equal = _mm256_cmpeq_epi8(vector,
+							  _mm256_set1_epi8
+							  (buffer[i]));
+			if (-1 == _mm256_movemask_epi8(equal)) {
+				counts[0][buffer[i]] += 32;
+				continue;
+			}
+			for (int k = 0; k < 32; k += 8) {
+				__histogram_count_word(counts, buffer + i + k);
+			}
+		}
+		__histogram_count_merge(counts, buffer, i, slab, table);
+
+		buffer += slab;
+		length -= slab;
+	}
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void __histogram_count_avx512(const unsigned char *buffer, size_t length,
+			      frequency_table_t table)
+{
+	uint32_t counts[8][HUFFMAN_MAX_SYMBOLS];
+
+	while (length > 0) {
+		size_t slab = length < HISTOGRAM_SLAB_SIZE ?
+		    length : HISTOGRAM_SLAB_SIZE;
+		memset(counts, 0, sizeof(counts));
+
+		size_t i = 0;
+		for (; i + 64 <= slab; i += 64) {
+			__m512i vector = _mm512_loadu_si512(buffer + i);
+			__mmask64 equal = _mm512_cmpeq_epi8_mask(vector,
+								 _mm512_set1_epi8
+								 (buffer[i]));
+			if (UINT64_MAX == equal) {
+				counts[0][buffer[i]] += 64;
+				continue;
+			}
+			for (int k = 0; k < 64; k += 8) {
+				__histogram_count_word(counts, buffer + i + k);
+			}
+		}
+		__histogram_count_merge(counts, buffer, i, slab, table);
+
+		buffer += slab;
+		length -= slab;
+	}
+}
+#endif
+
+histogram_kernel_t histogram_kernel(cpu_variant_t variant)
+{
+#if DISPATCH_X86
+	switch (variant) {
+	case CPU_VARIANT_SSE42:
+		return __histogram_count_sse42;
+	case CPU_VARIANT_AVX2:
+		return __histogram_count_avx2;
+	case CPU_VARIANT_AVX512:
+		return __histogram_count_avx512;
+	default:
+		break;
+	}
+#endif
+
+	return __histogram_count_scalar;
+}
+
+void histogram_count_buffer(const unsigned char *buffer, size_t length,
+			    frequency_table_t table)
+{
+	histogram_kernel(dispatch_variant())(buffer, length, table);
+}
+
+void *__histogram_count_range(void *argument)
+{
+	histogram_range_t *range = argument;
+	unsigned char *buffer = malloc(range->buffer_size);
+	range->status = NULL == buffer ? -1 : 0;
+
+	for (off_t offset = range->start;
+	     0 == range->status && offset < range->end;) {
+		size_t size = range->end - offset < (off_t)range->buffer_size ?
+		    (size_t)(range->end - offset) : range->buffer_size;
+
+		// Reads stop at chunk boundaries
+		frequency_t *table = range->table;
+		if (NULL != range->chunks) {
+			off_t chunk = (offset - range->origin) /
+			    (off_t)range->chunk_size;
+			off_t chunk_end = range->origin +
+			    (chunk + 1) * (off_t)range->chunk_size;
+			if (offset + (off_t)size > chunk_end)
+				size = chunk_end - offset;
+			table = range->chunks + chunk * HUFFMAN_MAX_SYMBOLS;
+		}
+
+		ssize_t length = pread(range->fd, buffer, size, offset);
+		if (length <= 0) {
+			range->status = -1;
+			break;
+		}
+
+		histogram_count_buffer(buffer, length, table);
+		offset += length;
+	}
+
+	free(buffer);
+	return NULL;
+}
+
+// Counts every range, the first one in the calling thread
+int __histogram_run(histogram_range_t *ranges, int threads)
+{
+	// Resolve the kernel before the threads share it
+	dispatch_variant();
+
+	for (int i = 1; i < threads; i++) {
+		if (0 == pthread_create(&ranges[i].thread, NULL,
+					__histogram_count_range, &ranges[i]))
+			ranges[i].started = true;
+	}
+
+	for (int i = 0; i < threads; i++) {
+		if (!ranges[i].started)
+			__histogram_count_range(&ranges[i]);
+	}
+
+	int status = 0;
+	for (int i = 0; i < threads; i++) {
+		if (ranges[i].started)
+			pthread_join(ranges[i].thread, NULL);
+		status |= ranges[i].status;
+	}
+
+	return 0 == status ? 0 : -1;
+}
+
+int histogram_count_parallel(int fd, off_t start, off_t end, int threads,
+			     frequency_table_t table)
+{
+	if (threads < 1)
+		threads = 1;
+
+	histogram_range_t *ranges = calloc(threads, sizeof(histogram_range_t));
+	// GCOV_EXCL_START
+	if (NULL == ranges)
+		return -1;
+	// GCOV_EXCL_STOP
+
+	off_t step = (end - start) / threads;
+	for (int i = 0; i < threads; i++) {
+		histogram_range_t *range = &ranges[i];
+		range->fd = fd;
+		range->start = start + i * step;
+		range->end = i == threads - 1 ? end : range->start + step;
+		range->buffer_size = memory_plan()->buffer_size;
+	}
+
+	int status = __histogram_run(ranges, threads);
+
+	// Counts are merged in range order: the sums are those of one pass
+	for (int i = 0; i < threads; i++) {
+		for (int j = 0; j < HUFFMAN_MAX_SYMBOLS; j++) {
+			table[j] += ranges[i].table[j];
+		}
+	}
+
+	free(ranges);
+	return status;
+}
+
+int histogram_count_chunks(int fd, off_t start, off_t end, size_t chunk_size,
+			   int threads, frequency_t *chunks)
+{
+	if (threads < 1)
+		threads = 1;
+
+	histogram_range_t *ranges = calloc(threads, sizeof(histogram_range_t));
+	// GCOV_EXCL_START
+	if (NULL == ranges)
+		return -1;
+	// GCOV_EXCL_STOP
+
+	// Each thread counts whole chunks: no table is shared
+	off_t count = (end - start + chunk_size - 1) / chunk_size;
+	off_t step = (count + threads - 1) / threads * chunk_size;
+	for (int i = 0; i < threads; i++) {
+		histogram_range_t *range = &ranges[i];
+		range->fd = fd;
+		range->start = start + i * step;
+		range->end = range->start + step < end ?
+		    range->start + step : end;
+		if (range->start > end)
+			range->start = end;
+		range->buffer_size = memory_plan()->buffer_size;
+		range->origin = start;
+		range->chunk_size = chunk_size;
+		range->chunks = chunks;
+	}
+
+	int status = __histogram_run(ranges, threads);
+
+	free(ranges);
+	return status;
+}
+
+int histogram_count(FILE *file, frequency_table_t table)
+{
+	long start = ftell(file);
+	if (start < 0 || 0 != fseek(file, 0, SEEK_END))
+		return -1;
+	long end = ftell(file);
+	if (end < 0)
+		return -1;
+
+	return histogram_count_range(file, start, end - start, table);
+}
+
+int histogram_count_range(FILE *file, long start, long length,
+			  frequency_table_t table)
+{
+	if (0 != fseek(file, start, SEEK_SET))
+		return -1;
+
+	// Regular files large enough to keep every thread busy are counted
+	// in parallel ranges. A file that grows meanwhile is counted up to
+	// `length` only; one that shrinks is an error.
+	int threads = memory_plan()->threads;
+	int fd = fileno(file);
+	struct stat info;
+	if (threads > 1 && fd >= 0 && 0 == fstat(fd, &info)
+	    && S_ISREG(info.st_mode) && length >= 2 * HISTOGRAM_PARALLEL_MIN) {
+		if (length / threads < HISTOGRAM_PARALLEL_MIN)
+			threads = length / HISTOGRAM_PARALLEL_MIN;
+
+		int status = histogram_count_parallel(fd, start, start + length,
+						      threads, table);
+		if (0 != fseek(file, start + length, SEEK_SET))
+			return -1;
+		return status;
+	}
+
+	size_t size = memory_plan()->buffer_size;
+	unsigned char *buffer = malloc(size);
+	// GCOV_EXCL_START
+	if (NULL == buffer)
+		return -1;
+	// GCOV_EXCL_STOP
+
+	long remaining = length;
+	size_t read;
+	while (remaining > 0
+	       && (read = fread(buffer, 1, remaining < (long)size ?
+				(size_t)remaining : size, file)) > 0) {
+		histogram_count_buffer(buffer, read, table);
+		remaining -= read;
+	}
+
+	int status = ferror(file) || remaining > 0 ? -1 : 0;
+	free(buffer);
+
+	return status;
+}
+
+int histogram_sample(FILE *file, long start, long length,
+		     frequency_table_t table)
+{
+	if (length < HISTOGRAM_SAMPLE_THRESHOLD)
+		return histogram_count_range(file, start, length, table);
+
+	size_t size = memory_plan()->buffer_size;
+	if (size > HISTOGRAM_SAMPLE_CHUNK_SIZE)
+		size = HISTOGRAM_SAMPLE_CHUNK_SIZE;
+	unsigned char *buffer = malloc(size);
+	// GCOV_EXCL_START
+	if (NULL == buffer)
+		return -1;
+	// GCOV_EXCL_STOP
+
+	frequency_t sample[HUFFMAN_MAX_SYMBOLS] = { 0 };
+	frequency_t sampled = 0;
+	long stride = length / HISTOGRAM_SAMPLE_CHUNKS;
+
+	// Chunks are spread evenly over the file, each one centered in its
+	// stride so that neither the head nor the tail is overrepresented.
+	for (int k = 0; k < HISTOGRAM_SAMPLE_CHUNKS; k++) {
+		long offset = start + k * stride +
+		    (stride - HISTOGRAM_SAMPLE_CHUNK_SIZE) / 2;
+		if (0 != fseek(file, offset, SEEK_SET))
+			goto fail;
+
+		// Under a memory limit, a chunk may span several buffers
+		for (size_t done = 0; done < HISTOGRAM_SAMPLE_CHUNK_SIZE;) {
+			size_t read = fread(buffer, 1, size, file);
+			if (0 == read)
+				break;
+			histogram_count_buffer(buffer, read, sample);
+			sampled += read;
+			done += read;
+		}
+	}
+
+	if (0 == sampled)
+		goto fail;
+
+	// Scale the sample to the whole file. Symbols the sample missed are
+	// escaped with a count of one: they still get a (long) code so that
+	// the encoder never meets a symbol without one.
+	double scale = (double)length / (double)sampled;
+	for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++) {
+		frequency_t estimate = (frequency_t) (sample[i] * scale);
+		frequencies_set(table, i, estimate > 0 ? estimate : 1);
+	}
+
+	free(buffer);
+	return 0;
+
+ fail:;
+	free(buffer);
+	return -1;
+}
+
+int histogram_build(FILE *file, compression_level_t level,
+		    frequency_table_t table)
+{
+	if (COMPRESSION_LEVEL_NORMAL == level)
+		return histogram_count(file, table);
+
+	if (0 != fseek(file, 0, SEEK_END))
+		return -1;
+	long length = ftell(file);
+	if (length < 0 || 0 != fseek(file, 0, SEEK_SET))
+		return -1;
+
+	return histogram_sample(file, 0, length, table);
+}
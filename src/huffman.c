@@ -1,13 +1,24 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
-#include "huffman/encoding_table.h"
+#include "huffman/analysis.h"
+#include "huffman/archive.h"
+#include "huffman/codec.h"
+#include "huffman/dispatch.h"
+#include "huffman/histogram.h"
 #include "huffman/huffman.h"
-#include "huffman/huffman_tree.h"
+#include "huffman/memory.h"
+#include "huffman/output.h"
+#include "huffman/segments.h"
+#include "huffman/server.h"
 #include "huffman/statistics.h"
-#include "types/queue.h"
+#include "huffman/transform.h"
 
 void usage(const char *progname, const char *subcommand)
 {
@@ -17,14 +28,62 @@ void usage(const char *progname, const char *subcommand)
 		goto default_usage;
 
 	if (strcmp(subcommand, "compress") == 0) {
-		fprintf(stderr, "Usage: %s compress <input> [<output>]\n",
+		fprintf(stderr,
+			"Usage: %s compress [<options>] <input> [<output>]\n",
 			progname);
 		code = EXIT_FAILURE;
 		goto exit_program;
 	}
 
 	if (strcmp(subcommand, "decompress") == 0) {
-		fprintf(stderr, "Usage: %s decompress <input> <output>\n",
+		fprintf(stderr,
+			"Usage: %s decompress [<options>] <input> <output>\n",
+			progname);
+		code = EXIT_FAILURE;
+		goto exit_program;
+	}
+
+	if (strcmp(subcommand, "analyze") == 0) {
+		fprintf(stderr,
+			"Usage: %s analyze [--level=<fast|normal>] [--filters=<filters>] <input>...\n",
+			progname);
+		code = EXIT_FAILURE;
+		goto exit_program;
+	}
+
+	if (strcmp(subcommand, "archive") == 0) {
+		fprintf(stderr,
+			"Usage: %s archive [--table=<auto|own|shared>] <archive> <input>...\n",
+			progname);
+		code = EXIT_FAILURE;
+		goto exit_program;
+	}
+
+	if (strcmp(subcommand, "list") == 0) {
+		fprintf(stderr, "Usage: %s list <archive>\n", progname);
+		code = EXIT_FAILURE;
+		goto exit_program;
+	}
+
+	if (strcmp(subcommand, "extract") == 0) {
+		fprintf(stderr,
+			"Usage: %s extract [--threads=<n>] <archive> <directory> [<member>...]\n",
+			progname);
+		code = EXIT_FAILURE;
+		goto exit_program;
+	}
+
+	if (strcmp(subcommand, "serve") == 0) {
+		fprintf(stderr, "Usage: %s serve [--threads=<n>] <socket>\n",
+			progname);
+		code = EXIT_FAILURE;
+		goto exit_program;
+	}
+
+	if (strcmp(subcommand, "client") == 0) {
+		fprintf(stderr,
+			"Usage: %s client [--repeat=<n>] <socket> <compress|decompress> <input> <output>\n"
+			"       %s client <socket> stats\n", progname,
 			progname);
 		code = EXIT_FAILURE;
 		goto exit_program;
@@ -32,354 +91,659 @@ void usage(const char *progname, const char *subcommand)
 
  default_usage:
 	fprintf(stderr, "Usage:\n");
-	fprintf(stderr, "  %s compress <input> [<output>]\n", progname);
-	fprintf(stderr, "  %s decompress <input> <output>\n", progname);
+	fprintf(stderr, "  %s compress [<options>] <input> [<output>]\n",
+		progname);
+	fprintf(stderr, "  %s decompress [<options>] <input> <output>\n",
+		progname);
+	fprintf(stderr, "  %s analyze [<options>] <input>...\n", progname);
+	fprintf(stderr, "  %s archive [<options>] <archive> <input>...\n",
+		progname);
+	fprintf(stderr, "  %s list <archive>\n", progname);
+	fprintf(stderr,
+		"  %s extract [<options>] <archive> <directory> [<member>...]\n",
+		progname);
+	fprintf(stderr, "  %s serve [<options>] <socket>\n", progname);
+	fprintf(stderr,
+		"  %s client [<options>] <socket> <compress|decompress> <input> <output>\n",
+		progname);
+	fprintf(stderr, "  %s client <socket> stats\n", progname);
+	fprintf(stderr, "\nOptions:\n");
+	fprintf(stderr,
+		"  --level=<fast|normal>  fast estimates statistics from a sample\n"
+		"                         of the input, normal counts every byte\n"
+		"                         (default)\n");
+	fprintf(stderr,
+		"  --filters=<filters>    pre-transform the input: auto (default),\n"
+		"                         none, or a list of delta, mtf and rle\n"
+		"                         (e.g. delta,rle)\n");
+	fprintf(stderr,
+		"  --cpu=<variant>        force the kernel variant: scalar, sse4.2,\n"
+		"                         avx2 or avx512 (default: detected, or\n"
+		"                         the %s environment variable)\n",
+		DISPATCH_ENVIRONMENT);
+	fprintf(stderr,
+		"  --append               compress only the bytes added to the\n"
+		"                         input since the previous run, as a new\n"
+		"                         segment of the output\n");
+	fprintf(stderr,
+		"  --direct               write the output with O_DIRECT, around\n"
+		"                         the page cache\n");
+	fprintf(stderr,
+		"  --memory-limit=<size>  bound buffers, tables and threads to\n"
+		"                         the given size (e.g. 64M); smaller\n"
+		"                         limits trade speed for memory\n");
+	fprintf(stderr,
+		"  --table=<mode>         archive members with their own table,\n"
+		"                         a table shared by all of them, or\n"
+		"                         whichever is smaller (auto, default)\n");
+	fprintf(stderr,
+		"  --threads=<n>          threads counting frequencies, extracting\n"
+		"                         or serving requests (default: one per\n"
+		"                         online CPU)\n");
+	fprintf(stderr,
+		"  --repeat=<n>           send the client request n times and\n"
+		"                         report its latency percentiles\n");
 
  exit_program:
 	exit(code);
 }
 
-void read_file(FILE *file, frequency_table_t table)
-{
-	int c;
-	while ((c = fgetc(file)) != EOF) {
-		frequencies_increment(table, c);
-	}
-}
-
-queue build_queue(frequency_table_t table)
+// One thread per online CPU unless told otherwise
+int default_threads(int threads)
 {
-	queue queue =
-	    queue_create(FLAG_SORTED, huffman_tree_copy, huffman_tree_free,
-			 huffman_tree_compare);
-
-	for (int i = 0; i < 256; i++) {
-		statistic_t statistic = {.symbol = i,.count =
-			    frequencies_get(table, i)
-		};
-		if (0 == statistic.count)
-			continue;
-
-		huffman_tree_t huffman_tree = huffman_tree_create(&statistic);
-		queue_enqueue(&queue, &huffman_tree);
-		huffman_tree_destroy(&huffman_tree);
-	}
+	if (threads <= 0)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads <= 0)
+		threads = 1;
 
-	return queue;
+	return threads;
 }
 
-huffman_tree_t *build_huffman_tree(queue *queue)
+// <input>.huff
+char *default_output_filename(const char *filename)
 {
-	long length = queue_length(*queue);
-	while (length >= 2) {
-		huffman_tree_t *left = queue_dequeue(queue);
-		huffman_tree_t *right = queue_dequeue(queue);
-
-		statistic_t *left_statistic = huffman_tree_get_data(*left);
-		statistic_t *right_statistic = huffman_tree_get_data(*right);
-
-		statistic_t statistic = {.symbol = 0,.count =
-			    left_statistic->count + right_statistic->count
-		};
-
-		huffman_tree_t huffman_tree = huffman_tree_create(&statistic);
-		statistic_t *huffman_statistic =
-		    huffman_tree_get_data(huffman_tree);
-		huffman_tree_set_left(huffman_tree, *left);
-		huffman_tree_set_right(huffman_tree, *right);
-
-		queue_enqueue(queue, &huffman_tree);
-		free(huffman_tree);
-		free(huffman_statistic);
-		free(left);
-		free(right);
-		length--;
-	}
+	char *output_filename = malloc(strlen(filename) + 6);
+	strcpy(output_filename, filename);
+	strcat(output_filename, ".huff");
+	output_filename[strlen(filename) + 5] = '\0';
 
-	return queue_dequeue(queue);
+	return output_filename;
 }
 
-void build_encoding_table_recursive(const huffman_tree_t huffman_tree,
-				    encoding_table_t encoding_table,
-				    encoding_t *encoding)
+int compress(const char *filename, char *output_filename,
+	     compression_level_t level, unsigned char filters, int direct)
 {
-	if (NULL == huffman_tree || binary_tree_is_leaf(huffman_tree)) {
-		if (encoding_length(*encoding) < 1) {
-			encoding_set(encoding, 0, 1);
-		}
+	clock_t start = clock();
+	memory_phases_start();
 
-		encoding_table[huffman_tree_get_data(huffman_tree)->symbol] =
-		    *encoding;
-		return;
+	int has_output_filename = 1;
+	if (NULL == output_filename) {
+		has_output_filename = 0;
+		output_filename = default_output_filename(filename);
 	}
 
-	encoding_t encodingLeft = encoding_copy(*encoding);
-	encoding_t encodingRight = encoding_copy(*encoding);
-	encoding_destroy(encoding);
+	int status = -1;
+	FILE *input = fopen(filename, "r");
+	if (NULL == input)
+		goto finalize;
 
-	if (huffman_tree_get_left(huffman_tree) != NULL) {
-		encoding_set(&encodingLeft, encoding_length(encodingLeft), 0);
-		build_encoding_table_recursive(huffman_tree_get_left
-					       (huffman_tree), encoding_table,
-					       &encodingLeft);
+	// The size is reserved once the tables give it
+	output_t output;
+	if (0 != (direct ? output_open_direct(&output, output_filename, 0) :
+		  output_open(&output, output_filename, 0))) {
+		fclose(input);
+		goto finalize;
 	}
+	if (direct && !output_is_direct(&output))
+		fprintf(stderr, "Direct I/O is not supported for %s\n",
+			output_filename);
 
-	if (huffman_tree_get_right(huffman_tree) != NULL) {
-		encoding_set(&encodingRight, encoding_length(encodingRight), 1);
-		build_encoding_table_recursive(huffman_tree_get_right
-					       (huffman_tree), encoding_table,
-					       &encodingRight);
-	}
-}
+	codec_t codec;
+	codec_create(&codec);
+	status = compress_output(input, &output, level, filters, &codec);
+	codec_destroy(&codec);
 
-int build_encoding_table(const huffman_tree_t huffman_tree,
-			 encoding_table_t table)
-{
-	encoding_t encoding = encoding_create();
-	build_encoding_table_recursive(huffman_tree, table, &encoding);
+	fclose(input);
+	if (0 != output_close(&output))
+		status = -1;
 
-	return 0;
+ finalize:;
+	if (0 == has_output_filename)
+		free(output_filename);
+
+	clock_t end = clock();
+	double elapsed = (double)(end - start) / CLOCKS_PER_SEC;
+
+	printf("Elapsed time: %.2fs\n", elapsed);
+	memory_phases_report(stdout);
+
+	return status;
 }
 
-void write_compressed_file(const char *filename, char *output_filename,
-			   frequency_table_t frequency_table,
-			   encoding_table_t encoding_table)
+// Compresses the bytes added to `filename` since the previous run, as a
+// new segment of the output
+int append(const char *filename, char *output_filename,
+	   compression_level_t level, unsigned char filters)
 {
+	clock_t start = clock();
+	memory_phases_start();
+
 	int has_output_filename = 1;
 	if (NULL == output_filename) {
 		has_output_filename = 0;
-		output_filename = malloc(strlen(filename) + 6);
-		strcpy(output_filename, filename);
-		strcat(output_filename, ".huff");
-		output_filename[strlen(filename) + 5] = '\0';
+		output_filename = default_output_filename(filename);
 	}
 
-	FILE *input = fopen(filename, "r");
-	if (NULL == input)
-		return;
+	long unsigned int appended = 0;
+	int status = segments_append(filename, output_filename, level, filters,
+				     &appended);
+	if (0 != status)
+		fprintf(stderr, "Failed to append %s to %s\n", filename,
+			output_filename);
+	else
+		printf("Appended %lu bytes\n", appended);
 
-	FILE *output = fopen(output_filename, "w");
-	if (NULL == output)
-		return;
+	if (0 == has_output_filename)
+		free(output_filename);
 
-	// "HUFF" magic number
-	fwrite("HUFF", sizeof(char), 4, output);
-	// Length of original file
-	fseek(input, 0, SEEK_END);
-	long file_length = ftell(input);
-	fwrite(&file_length, sizeof(file_length), 1, output);
-	fseek(input, 0, SEEK_SET);
+	clock_t end = clock();
+	double elapsed = (double)(end - start) / CLOCKS_PER_SEC;
 
-	if (NULL == frequency_table || NULL == encoding_table) {
-		goto finalize;
-	}
-	// Number of symbols
-	unsigned int symbol_count = 0;
-	for (int i = 0; i < 256; i++) {
-		if (0 != frequency_table[i]) {
-			symbol_count++;
-		}
+	printf("Elapsed time: %.2fs\n", elapsed);
+	memory_phases_report(stdout);
+
+	return status;
+}
+
+int decompress_stream(FILE *input, char *output_filename, int direct)
+{
+	stream_header_t header;
+	frequency_table_t frequency_table = NULL;
+
+	if (0 != read_compressed_file(input, &header, &frequency_table)) {
+		frequencies_destroy(&frequency_table);
+		return -1;
 	}
-	--symbol_count;
-	fwrite(&symbol_count, sizeof(char), 1, output);
-	// Frequencies
-	for (int i = 0; i < 256; i++) {
-		if (0 != frequency_table[i]) {
-			fwrite(&i, sizeof(char), 1, output);
-			fwrite(&frequency_table[i], sizeof(frequency_table[i]),
-			       1, output);
-		}
+
+	codec_t codec;
+	codec_create(&codec);
+	if (0 != header.file_length)
+		codec_prepare(&codec, frequency_table);
+	memory_phase_end("tables");
+
+	// The header gives the exact output size: preallocate and map the
+	// destination so that symbols are stored directly into it.
+	output_t output;
+	if (0 != (direct ?
+		  output_open_direct(&output, output_filename,
+				     header.file_length) :
+		  output_open(&output, output_filename, header.file_length))) {
+		frequencies_destroy(&frequency_table);
+		codec_destroy(&codec);
+		return -1;
 	}
+	if (direct && !output_is_direct(&output))
+		fprintf(stderr, "Direct I/O is not supported for %s\n",
+			output_filename);
+	int status = write_file(input, &output, &header, &codec);
 
-	int c;
-	char buffer = 0;
-	int buffer_length = 0;
+	if (0 != output_close(&output))
+		status = -1;
+	memory_phase_end("decode");
 
-	while ((c = fgetc(input)) != EOF) {
-		encoding_t encoding = encoding_table[c];
+	frequencies_destroy(&frequency_table);
+	codec_destroy(&codec);
 
-		for (int i = 0; i < encoding_length(encoding); i++) {
-			bit b = encoding_get(encoding, i);
-			buffer = (buffer << 1) | b;
-			buffer_length++;
+	return status;
+}
 
-			if (buffer_length == 8) {
-				fwrite(&buffer, sizeof(buffer), 1, output);
-				buffer = 0;
-				buffer_length = 0;
-			}
-		}
-	}
+// Files grown by appends hold one stream per segment, decoded in order
+// into the same output
+int decompress_segments(FILE *input, char *output_filename, int direct)
+{
+	segments_t segments;
+	if (0 != segments_open(&segments, input))
+		return -1;
 
-	if (buffer_length > 0) {
-		buffer = buffer << (8 - buffer_length);
-		fwrite(&buffer, sizeof(char), 1, output);
+	output_t output;
+	if (0 != (direct ?
+		  output_open_direct(&output, output_filename,
+				     segments.length) :
+		  output_open(&output, output_filename, segments.length))) {
+		segments_close(&segments);
+		return -1;
 	}
+	if (direct && !output_is_direct(&output))
+		fprintf(stderr, "Direct I/O is not supported for %s\n",
+			output_filename);
 
- finalize:;
-	fclose(input);
-	fclose(output);
+	codec_t codec;
+	codec_create(&codec);
+	int status = segments_decode(&segments, input, &output, &codec);
+	if (0 != output_close(&output))
+		status = -1;
+	memory_phase_end("decode");
 
-	if (0 == has_output_filename)
-		free(output_filename);
+	codec_destroy(&codec);
+	segments_close(&segments);
+
+	return status;
 }
 
-int compress(const char *filename, char *output_filename)
+int decompress(const char *filename, char *output_filename, int direct)
 {
 	clock_t start = clock();
+	memory_phases_start();
 
-	frequency_table_t frequency_table;
-	frequencies_create(&frequency_table);
-
-	FILE *file = fopen(filename, "r");
-	if (NULL == file)
+	FILE *input = fopen(filename, "r");
+	if (NULL == input)
 		return -1;
 
-	read_file(file, frequency_table);
-	if (0 != fclose(file))
-		return -1;
+	int status = segments_present(input) ?
+	    decompress_segments(input, output_filename, direct) :
+	    0 == fseek(input, 0, SEEK_SET) ?
+	    decompress_stream(input, output_filename, direct) : -1;
+	fclose(input);
 
-	queue queue = build_queue(frequency_table);
+	clock_t end = clock();
+	double elapsed = (double)(end - start) / CLOCKS_PER_SEC;
 
-	huffman_tree_t *huffman_tree = build_huffman_tree(&queue);
-	queue_destroy(&queue);
+	printf("Elapsed time: %.2fs\n", elapsed);
+	memory_phases_report(stdout);
 
-	if (NULL == huffman_tree) {
-		write_compressed_file(filename, output_filename, NULL, NULL);
-		goto finalize;
+	return status;
+}
+
+int analyze(char *const *filenames, int count, compression_level_t level,
+	    unsigned char filters)
+{
+	codec_t codec;
+	codec_create(&codec);
+
+	int status = 0;
+	for (int i = 0; i < count; i++) {
+		FILE *input = fopen(filenames[i], "r");
+		analysis_t analysis;
+		if (NULL == input
+		    || 0 != analyze_stream(input, level, filters, &codec,
+					   &analysis)) {
+			fprintf(stderr, "Failed to analyze %s\n", filenames[i]);
+			status = -1;
+		} else {
+			if (i > 0)
+				printf("\n");
+			analysis_print(stdout, filenames[i], &analysis);
+		}
+
+		if (NULL != input)
+			fclose(input);
 	}
 
-	encoding_t encoding_table[256] = { 0 };
-	build_encoding_table(*huffman_tree, encoding_table);
-	huffman_tree_free(huffman_tree);
+	codec_destroy(&codec);
 
-	write_compressed_file(filename, output_filename, frequency_table,
-			      encoding_table);
-	encoding_table_destroy(encoding_table);
+	return status;
+}
 
- finalize:;
-	frequencies_destroy(&frequency_table);
+int create_archive(const char *filename, char *const *paths, int count,
+		   archive_table_t table)
+{
+	clock_t start = clock();
+	memory_phases_start();
+
+	int status = archive_create(filename, paths, count, table);
+	if (0 != status)
+		fprintf(stderr, "Failed to create %s\n", filename);
 
 	clock_t end = clock();
 	double elapsed = (double)(end - start) / CLOCKS_PER_SEC;
 
 	printf("Elapsed time: %.2fs\n", elapsed);
-	return 0;
+	memory_phases_report(stdout);
+
+	return status;
 }
 
-int read_compressed_file(FILE *file, long unsigned int *file_length,
-			 unsigned int *symbol_count,
-			 frequency_table_t *frequency_table)
+int list_archive(const char *filename)
 {
-	char magic[4];
-	if (fread(magic, sizeof(char), 4, file) != 4)
-		return -1;
-	if (0 != strncmp(magic, "HUFF", 4))
+	archive_t archive;
+	if (0 != archive_open(&archive, filename)) {
+		fprintf(stderr, "Failed to read %s\n", filename);
 		return -1;
+	}
 
-	if (fread(file_length, sizeof(*file_length), 1, file) != 1)
-		return -1;
+	printf("%12s %12s %7s %6s  %s\n", "Length", "Size", "Ratio", "Table",
+	       "Name");
+	for (unsigned int i = 0; i < archive.count; i++) {
+		archive_member_t *member = &archive.members[i];
+		printf("%12lu %12lu %6.1f%% %6s  %s\n", member->length,
+		       member->size,
+		       0 == member->length ? 100.0 :
+		       100.0 * member->size / member->length,
+		       (member->flags & ARCHIVE_MEMBER_SHARED) ? "shared" :
+		       "own", member->name);
+	}
 
-	if (0 == *file_length)
-		return 0;
+	archive_close(&archive);
+	return 0;
+}
+
+int extract_archive(const char *filename, const char *directory,
+		    char *const *names, int count, int threads)
+{
+	clock_t start = clock();
+	memory_phases_start();
 
-	if (fread(symbol_count, sizeof(char), 1, file) != 1)
+	archive_t archive;
+	if (0 != archive_open(&archive, filename)) {
+		fprintf(stderr, "Failed to read %s\n", filename);
 		return -1;
-	(*symbol_count)++;
+	}
 
-	frequencies_create(frequency_table);
-	for (int i = 0; i < *symbol_count; i++) {
-		unsigned char symbol = 0;
-		long unsigned int frequency = 0;
-		if (fread(&symbol, sizeof(symbol), 1, file) != 1)
-			return -1;
-		if (fread(&frequency, sizeof(frequency), 1, file) != 1)
-			return -1;
-		frequencies_set(*frequency_table, symbol, frequency);
+	// All members, or the named ones
+	unsigned int selected =
+	    0 == count ? archive.count : (unsigned int)count;
+	unsigned int *indices = malloc((selected + 1) * sizeof(unsigned int));
+	int status = NULL == indices ? -1 : 0;
+	for (unsigned int i = 0; 0 == status && i < selected; i++) {
+		int index =
+		    0 == count ? (int)i : archive_find(&archive, names[i]);
+		if (index < 0) {
+			fprintf(stderr, "No member %s in %s\n", names[i],
+				filename);
+			status = -1;
+		}
+		indices[i] = index;
 	}
 
-	return 0;
+	// Under a memory limit, buffers are split between the threads
+	threads = memory_configure(memory_plan()->limit,
+				   default_threads(threads))->threads;
+
+	if (0 == status) {
+		status = archive_extract(&archive, indices, selected,
+					 directory, threads);
+		if (0 != status)
+			fprintf(stderr, "Failed to extract from %s\n",
+				filename);
+	}
+	memory_phase_end("decode");
+
+	free(indices);
+	archive_close(&archive);
+
+	clock_t end = clock();
+	double elapsed = (double)(end - start) / CLOCKS_PER_SEC;
+
+	printf("Elapsed time: %.2fs\n", elapsed);
+	memory_phases_report(stdout);
+
+	return status;
 }
 
-void write_file(FILE *file, FILE *output,
-		const long unsigned int file_length,
-		const huffman_tree_t *huffman_tree)
+static server_t *serve_instance = NULL;
+
+void serve_signal(int signal)
 {
-	if (0 == file_length)
-		return;
+	(void)signal;
+	if (NULL != serve_instance)
+		server_stop(serve_instance);
+}
 
-	huffman_tree_t current = *huffman_tree;
-	long unsigned int length = 0;
+int serve(const char *socket_path, int threads, size_t memory_limit)
+{
+	threads = default_threads(threads);
+	const memory_plan_t *plan = memory_configure(memory_limit, threads);
+	if (plan->threads < threads) {
+		fprintf(stderr,
+			"Memory limit of %zu bytes: using %d threads instead of %d\n",
+			memory_limit, plan->threads, threads);
+		threads = plan->threads;
+	}
 
-	while (length < file_length) {
-		int c = fgetc(file);
+	static server_t server;
+	if (0 != server_create(&server, socket_path, threads)) {
+		fprintf(stderr, "Failed to listen on %s\n", socket_path);
+		return -1;
+	}
+	serve_instance = &server;
 
-		int i = 0;
-		for (i = 0; i < 8; i++) {
-			unsigned char bit = (c >> (7 - i)) & 0x1;
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = serve_signal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
 
-			if (binary_tree_is_leaf(current)) {
-				statistic_t *statistic =
-				    huffman_tree_get_data(current);
-				fputc(statistic->symbol, output);
-				length++;
-				if (length == file_length)
-					break;
+	fprintf(stderr, "Listening on %s with %d threads\n", socket_path,
+		threads);
+	int status = server_run(&server);
 
-				current = *huffman_tree;
-			}
+	server_latency_t latency;
+	server_latency(&server, &latency);
+	fprintf(stderr,
+		"Requests: %lu, latency (us): p50 %.1f, p90 %.1f, p99 %.1f, "
+		"p99.9 %.1f, max %.1f\n", latency.count, latency.p50,
+		latency.p90, latency.p99, latency.p999, latency.max);
 
-			if (0 == bit)
-				current = huffman_tree_get_left(current);
-			else
-				current = huffman_tree_get_right(current);
+	serve_instance = NULL;
+	server_destroy(&server);
 
-			if (NULL == current)
-				current = *huffman_tree;
-		}
+	return status;
+}
+
+unsigned char *read_whole_file(const char *filename, size_t *length)
+{
+	FILE *file = fopen(filename, "r");
+	if (NULL == file)
+		return NULL;
+
+	unsigned char *buffer = NULL;
+	if (0 != fseek(file, 0, SEEK_END))
+		goto finalize;
+	long size = ftell(file);
+	if (size < 0 || 0 != fseek(file, 0, SEEK_SET))
+		goto finalize;
+
+	buffer = malloc(size > 0 ? size : 1);
+	if (NULL != buffer && fread(buffer, 1, size, file) != (size_t)size) {
+		free(buffer);
+		buffer = NULL;
 	}
+	*length = size;
+
+ finalize:;
+	fclose(file);
+	return buffer;
 }
 
-int decompress(const char *filename, char *output_filename)
+int compare_double(const void *a, const void *b)
 {
-	clock_t start = clock();
+	double x = *(const double *)a;
+	double y = *(const double *)b;
 
-	FILE *input = fopen(filename, "r");
-	if (NULL == input)
+	return (x > y) - (x < y);
+}
+
+int client(const char *socket_path, const char *operation_name,
+	   const char *filename, const char *output_filename, int repeat)
+{
+	server_operation_t operation;
+	if (0 == strcmp(operation_name, "compress"))
+		operation = SERVER_COMPRESS;
+	else if (0 == strcmp(operation_name, "decompress"))
+		operation = SERVER_DECOMPRESS;
+	else if (0 == strcmp(operation_name, "stats"))
+		operation = SERVER_STATS;
+	else
 		return -1;
 
-	long unsigned int file_length = 0;
-	unsigned int symbol_count = 0;
-	frequency_table_t frequency_table = NULL;
+	size_t length = 0;
+	unsigned char *payload = NULL;
+	if (SERVER_STATS != operation) {
+		payload = read_whole_file(filename, &length);
+		if (NULL == payload) {
+			fprintf(stderr, "Failed to read %s\n", filename);
+			return -1;
+		}
+	}
 
-	if (0 != read_compressed_file(input, &file_length, &symbol_count,
-				      &frequency_table))
+	int fd = client_connect(socket_path);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to connect to %s\n", socket_path);
+		free(payload);
 		return -1;
+	}
 
-	huffman_tree_t *huffman_tree = NULL;
-	if (0 == file_length)
-		goto _out;
+	if (repeat < 1)
+		repeat = 1;
+	double *latencies = malloc(repeat * sizeof(double));
+
+	int status = 0;
+	unsigned char *response = NULL;
+	size_t response_length = 0;
+	for (int i = 0; i < repeat && 0 == status; i++) {
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		status = client_request(fd, operation, payload, length,
+					&response, &response_length);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		if (NULL != latencies)
+			latencies[i] = (end.tv_sec - start.tv_sec) * 1e6 +
+			    (end.tv_nsec - start.tv_nsec) / 1e3;
+	}
+	close(fd);
+
+	if (0 != status) {
+		fprintf(stderr, "Request failed with status %d\n", status);
+	} else if (SERVER_STATS == operation) {
+		fwrite(response, 1, response_length, stdout);
+	} else {
+		FILE *output = fopen(output_filename, "w");
+		if (NULL == output
+		    || fwrite(response, 1, response_length, output) !=
+		    response_length)
+			status = -1;
+		if (NULL != output && 0 != fclose(output))
+			status = -1;
+	}
 
-	queue queue = build_queue(frequency_table);
-	huffman_tree = build_huffman_tree(&queue);
-	queue_destroy(&queue);
+	if (0 == status && repeat > 1 && NULL != latencies) {
+		qsort(latencies, repeat, sizeof(double), compare_double);
+		fprintf(stderr,
+			"Requests: %d, latency (us): p50 %.1f, p90 %.1f, "
+			"p99 %.1f, max %.1f\n", repeat,
+			latencies[(int)(0.5 * (repeat - 1))],
+			latencies[(int)(0.9 * (repeat - 1))],
+			latencies[(int)(0.99 * (repeat - 1))],
+			latencies[repeat - 1]);
+	}
 
- _out:	;
-	FILE *output = fopen(output_filename, "w");
-	write_file(input, output, file_length, huffman_tree);
+	free(latencies);
+	free(response);
+	free(payload);
 
-	fclose(input);
-	fclose(output);
+	return status;
+}
 
-	frequencies_destroy(&frequency_table);
-	huffman_tree_free(huffman_tree);
+typedef struct options_t {
+	compression_level_t level;
+	unsigned char filters;
+	archive_table_t table;
+	int append;
+	int direct;
+	int threads;
+	int repeat;
+	size_t memory_limit;
+	int argc;
+	char **argv;
+} options_t;
+
+void parse_options(int argc, char **argv, options_t *options)
+{
+	options->level = COMPRESSION_LEVEL_NORMAL;
+	options->filters = TRANSFORM_AUTO;
+	options->table = ARCHIVE_TABLE_AUTO;
+	options->append = 0;
+	options->direct = 0;
+	options->threads = 0;
+	options->repeat = 1;
+	options->memory_limit = 0;
+	options->argc = 0;
+	options->argv = argv + 2;
+
+	for (int i = 2; i < argc; i++) {
+		if (0 == strncmp(argv[i], "--level=", 8)) {
+			if (0 != compression_level_parse(argv[i] + 8,
+							 &options->level))
+				usage(argv[0], argv[1]);
+			continue;
+		}
 
-	clock_t end = clock();
-	double elapsed = (double)(end - start) / CLOCKS_PER_SEC;
+		if (0 == strncmp(argv[i], "--filters=", 10)) {
+			if (0 != transform_parse(argv[i] + 10,
+						 &options->filters))
+				usage(argv[0], argv[1]);
+			continue;
+		}
 
-	printf("Elapsed time: %.2fs\n", elapsed);
+		if (0 == strcmp(argv[i], "--append")) {
+			options->append = 1;
+			continue;
+		}
 
-	return 0;
+		if (0 == strcmp(argv[i], "--direct")) {
+			options->direct = 1;
+			continue;
+		}
+
+		if (0 == strncmp(argv[i], "--table=", 8)) {
+			if (0 != archive_table_parse(argv[i] + 8,
+						     &options->table))
+				usage(argv[0], argv[1]);
+			continue;
+		}
+
+		if (0 == strncmp(argv[i], "--threads=", 10)) {
+			options->threads = atoi(argv[i] + 10);
+			if (options->threads <= 0)
+				usage(argv[0], argv[1]);
+			continue;
+		}
+
+		if (0 == strncmp(argv[i], "--repeat=", 9)) {
+			options->repeat = atoi(argv[i] + 9);
+			if (options->repeat <= 0)
+				usage(argv[0], argv[1]);
+			continue;
+		}
+
+		if (0 == strncmp(argv[i], "--memory-limit=", 15)) {
+			if (0 != memory_parse_size(argv[i] + 15,
+						   &options->memory_limit))
+				usage(argv[0], argv[1]);
+			continue;
+		}
+
+		if (0 == strncmp(argv[i], "--cpu=", 6)) {
+			cpu_variant_t variant;
+			if (0 != cpu_variant_parse(argv[i] + 6, &variant))
+				usage(argv[0], argv[1]);
+			if (0 != dispatch_select(variant)) {
+				fprintf(stderr,
+					"Variant not supported by this CPU: %s\n",
+					argv[i] + 6);
+				exit(EXIT_FAILURE);
+			}
+			continue;
+		}
+
+		if (0 == strncmp(argv[i], "--", 2))
+			usage(argv[0], argv[1]);
+
+		options->argv[options->argc++] = argv[i];
+	}
+
+	options->argv[options->argc] = NULL;
 }
 
 int main(int argc, char **argv)
@@ -387,18 +751,75 @@ int main(int argc, char **argv)
 	if (argc < 2)
 		usage(argv[0], NULL);
 
+	// Resolve the kernel variant once, before any worker may run
+	dispatch_variant();
+
+	options_t options;
+	parse_options(argc, argv, &options);
+	// Frequencies are counted on several threads
+	int threads = strcmp(argv[1], "compress") == 0
+	    || strcmp(argv[1], "analyze") == 0
+	    || strcmp(argv[1], "archive") == 0 ?
+	    default_threads(options.threads) : 1;
+	memory_configure(options.memory_limit, threads);
+
+	int status = 0;
 	if (strcmp(argv[1], "compress") == 0) {
-		if (argc < 3)
+		if (options.argc < 1)
 			usage(argv[0], "compress");
 
-		compress(argv[2], argv[3]);
+		status = options.append ?
+		    append(options.argv[0], options.argv[1], options.level,
+			   options.filters) :
+		    compress(options.argv[0], options.argv[1], options.level,
+			     options.filters, options.direct);
 	} else if (strcmp(argv[1], "decompress") == 0) {
-		if (argc < 4)
+		if (options.argc < 2)
 			usage(argv[0], "decompress");
 
-		decompress(argv[2], argv[3]);
+		status = decompress(options.argv[0], options.argv[1],
+				    options.direct);
+	} else if (strcmp(argv[1], "analyze") == 0) {
+		if (options.argc < 1)
+			usage(argv[0], "analyze");
+
+		status = analyze(options.argv, options.argc, options.level,
+				 options.filters);
+	} else if (strcmp(argv[1], "archive") == 0) {
+		if (options.argc < 2)
+			usage(argv[0], "archive");
+
+		status = create_archive(options.argv[0], options.argv + 1,
+					options.argc - 1, options.table);
+	} else if (strcmp(argv[1], "list") == 0) {
+		if (options.argc < 1)
+			usage(argv[0], "list");
+
+		status = list_archive(options.argv[0]);
+	} else if (strcmp(argv[1], "extract") == 0) {
+		if (options.argc < 2)
+			usage(argv[0], "extract");
+
+		status = extract_archive(options.argv[0], options.argv[1],
+					 options.argv + 2, options.argc - 2,
+					 options.threads);
+	} else if (strcmp(argv[1], "serve") == 0) {
+		if (options.argc < 1)
+			usage(argv[0], "serve");
+
+		status = serve(options.argv[0], options.threads,
+			       options.memory_limit);
+	} else if (strcmp(argv[1], "client") == 0) {
+		if (options.argc < 2 || (0 != strcmp(options.argv[1], "stats")
+					 && options.argc < 4))
+			usage(argv[0], "client");
+
+		status = client(options.argv[0], options.argv[1],
+				options.argc > 2 ? options.argv[2] : NULL,
+				options.argc > 3 ? options.argv[3] : NULL,
+				options.repeat);
 	} else
 		usage(argv[0], NULL);
 
-	return 0;
+	return 0 == status ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,211 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "huffman/memory.h"
+
+static memory_plan_t memory_current = {
+	.limit = 0,
+	.buffer_size = MEMORY_BUFFER_MAX,
+	.map_limit = SIZE_MAX,
+	.thread_limit = SIZE_MAX,
+	.threads = 0
+};
+
+static struct {
+	const char *name;
+	size_t peak;
+} memory_phases[MEMORY_PHASES];
+static int memory_phase_count = 0;
+static bool memory_phases_enabled = false;
+
+int memory_parse_size(const char *text, size_t *size)
+{
+	char *end = NULL;
+	double value = strtod(text, &end);
+	if (end == text || !isfinite(value) || value < 0)
+		return -1;
+
+	double unit = 1;
+	switch (*end) {
+	case 'k':
+	case 'K':
+		unit = 1024.0;
+		end++;
+		break;
+	case 'm':
+	case 'M':
+		unit = 1024.0 * 1024;
+		end++;
+		break;
+	case 'g':
+	case 'G':
+		unit = 1024.0 * 1024 * 1024;
+		end++;
+		break;
+	default:
+		break;
+	}
+
+	if ('i' == *end && unit > 1)
+		end++;
+	if ('B' == *end || 'b' == *end)
+		end++;
+	if ('\0' != *end)
+		return -1;
+
+	// SIZE_MAX rounds up to a power of two as a double: past it, the
+	// conversion is undefined
+	if (value * unit >= (double)SIZE_MAX)
+		return -1;
+
+	*size = (size_t)(value * unit);
+	return 0;
+}
+
+size_t __memory_floor(size_t size)
+{
+	size_t power = MEMORY_BUFFER_MIN;
+	while (power * 2 <= size && power < MEMORY_BUFFER_MAX) {
+		power *= 2;
+	}
+
+	return power;
+}
+
+const memory_plan_t *memory_configure(size_t limit, int threads)
+{
+	if (threads < 1)
+		threads = 1;
+
+	memory_current.limit = limit;
+	memory_current.threads = threads;
+
+	if (0 == limit) {
+		memory_current.buffer_size = MEMORY_BUFFER_MAX;
+		memory_current.map_limit = SIZE_MAX;
+		memory_current.thread_limit = SIZE_MAX;
+		return &memory_current;
+	}
+
+	// Below the baseline there is nothing left to trade: run with the
+	// smallest buffers rather than refuse to work.
+	size_t available =
+	    limit > MEMORY_BASELINE ? limit - MEMORY_BASELINE : 0;
+
+	// Shrink buffers down to the preferred size first, then give up
+	// threads, then shrink buffers down to the minimum.
+	size_t per_thread = available / threads;
+	size_t buffers = MEMORY_BUFFERS_PER_THREAD * MEMORY_BUFFER_PREFERRED;
+	if (per_thread < buffers) {
+		threads = available / buffers;
+		if (threads < 1)
+			threads = 1;
+		per_thread = available / threads;
+	}
+
+	memory_current.threads = threads;
+	memory_current.buffer_size =
+	    __memory_floor(per_thread / MEMORY_BUFFERS_PER_THREAD);
+	memory_current.thread_limit = per_thread;
+	// Pages of a mapped output stay resident until written back: only
+	// map outputs that fit in what the buffers leave.
+	memory_current.map_limit = available / 2;
+
+	return &memory_current;
+}
+
+const memory_plan_t *memory_plan(void)
+{
+	return &memory_current;
+}
+
+// Returns 0 when the size cannot be known
+size_t memory_physical(void)
+{
+	long pages = sysconf(_SC_PHYS_PAGES);
+	long page_size = sysconf(_SC_PAGESIZE);
+	if (pages <= 0 || page_size <= 0)
+		return 0;
+
+	return (size_t)pages * page_size;
+}
+
+size_t memory_peak(void)
+{
+	FILE *status = fopen("/proc/self/status", "r");
+	if (NULL != status) {
+		char line[128];
+		size_t peak = 0;
+		while (NULL != fgets(line, sizeof(line), status)) {
+			if (0 == strncmp(line, "VmHWM:", 6)) {
+				peak = strtoul(line + 6, NULL, 10) * 1024;
+				break;
+			}
+		}
+		fclose(status);
+
+		if (peak > 0)
+			return peak;
+	}
+
+	struct rusage usage;
+	if (0 != getrusage(RUSAGE_SELF, &usage))
+		return 0;
+
+	return (size_t)usage.ru_maxrss * 1024;
+}
+
+void __memory_reset_peak(void)
+{
+	// Linux resets the peak resident set size (VmHWM) on "5"; elsewhere
+	// phases report the peak since the start of the process.
+	FILE *clear_refs = fopen("/proc/self/clear_refs", "w");
+	if (NULL == clear_refs)
+		return;
+
+	fputs("5", clear_refs);
+	fclose(clear_refs);
+}
+
+void memory_phases_start(void)
+{
+	memory_phases_enabled = true;
+	memory_phase_count = 0;
+	__memory_reset_peak();
+}
+
+void memory_phase_end(const char *name)
+{
+	if (!memory_phases_enabled || MEMORY_PHASES == memory_phase_count)
+		return;
+
+	memory_phases[memory_phase_count].name = name;
+	memory_phases[memory_phase_count].peak = memory_peak();
+	memory_phase_count++;
+
+	__memory_reset_peak();
+}
+
+void memory_phases_report(FILE *stream)
+{
+	if (!memory_phases_enabled)
+		return;
+
+	fprintf(stream, "Peak memory:");
+	for (int i = 0; i < memory_phase_count; i++) {
+		fprintf(stream, "%s %s %.1f MiB", 0 == i ? "" : ",",
+			memory_phases[i].name,
+			memory_phases[i].peak / (1024.0 * 1024.0));
+	}
+	fprintf(stream, "\n");
+
+	memory_phases_enabled = false;
+}
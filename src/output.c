@@ -0,0 +1,329 @@
+// O_DIRECT is a Linux extension
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "huffman/memory.h"
+#include "huffman/output.h"
+
+void __output_init(output_t *output, int fd, size_t length)
+{
+	output->fd = fd;
+	output->file = NULL;
+	output->map = NULL;
+	output->direct = NULL;
+	output->direct_length = 0;
+	output->direct_capacity = 0;
+	output->failed = 0;
+	output->length = length;
+	output->position = 0;
+}
+
+int __output_open_buffered(output_t *output)
+{
+	output->map = NULL;
+	output->file = fdopen(output->fd, "w");
+	if (NULL == output->file) {
+		close(output->fd);
+		return -1;
+	}
+
+	const memory_plan_t *plan = memory_plan();
+	setvbuf(output->file, NULL, _IOFBF,
+		0 == plan->limit ? OUTPUT_BUFFER_SIZE : plan->buffer_size);
+	return 0;
+}
+
+int __output_open_mapped(output_t *output)
+{
+	// posix_fallocate reserves the blocks up front so that stores into
+	// the mapping cannot fault with SIGBUS on a full disk; filesystems
+	// that do not support it still get a sparse file from ftruncate.
+	int status = posix_fallocate(output->fd, 0, output->length);
+	if (0 != status && EINVAL != status && EOPNOTSUPP != status)
+		return -1;
+
+	if (0 != ftruncate(output->fd, output->length))
+		return -1;
+
+	void *map = mmap(NULL, output->length, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, output->fd, 0);
+	if (MAP_FAILED == map)
+		return -1;
+
+	output->map = map;
+	output->file = NULL;
+	return 0;
+}
+
+int output_open(output_t *output, const char *filename, size_t length)
+{
+	__output_init(output, -1, length);
+
+	// Pipes and devices cannot be mapped, nor opened read-write without
+	// side effects: write to them through stdio.
+	struct stat info;
+	if (0 == stat(filename, &info) && !S_ISREG(info.st_mode)) {
+		output->fd = open(filename, O_WRONLY);
+		if (output->fd < 0)
+			return -1;
+
+		return __output_open_buffered(output);
+	}
+
+	output->fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if (output->fd < 0)
+		return -1;
+
+	if (0 != length && length <= memory_plan()->map_limit
+	    && 0 == __output_open_mapped(output))
+		return 0;
+
+	// The mapping may have failed once the file was sized: a short
+	// buffered write must not leave the reserved length behind it
+	if (0 != ftruncate(output->fd, 0)) {
+		close(output->fd);
+		return -1;
+	}
+
+	return __output_open_buffered(output);
+}
+
+int output_open_buffer(output_t *output, unsigned char *buffer,
+		       size_t length)
+{
+	__output_init(output, -1, length);
+	output->map = buffer;
+
+	return NULL == buffer && length > 0 ? -1 : 0;
+}
+
+int output_open_stream(output_t *output, FILE *file)
+{
+	// Caller-owned stream, of unknown length: it is flushed, not closed
+	__output_init(output, -1, 0);
+	output->file = file;
+
+	return NULL == file ? -1 : 0;
+}
+
+int output_open_direct(output_t *output, const char *filename, size_t length)
+{
+	struct stat info;
+	if (0 == stat(filename, &info) && !S_ISREG(info.st_mode))
+		return output_open(output, filename, length);
+
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+	flags |= O_DIRECT;
+#endif
+	__output_init(output, open(filename, flags, 0666), length);
+	// Filesystems without direct I/O (tmpfs) refuse the flag: the
+	// aligned writes still work through the page cache.
+	if (output->fd < 0 && EINVAL == errno)
+		output->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (output->fd < 0)
+		return -1;
+
+	const memory_plan_t *plan = memory_plan();
+	size_t capacity = 0 == plan->limit ? OUTPUT_BUFFER_SIZE :
+	    plan->buffer_size;
+	capacity -= capacity % OUTPUT_DIRECT_ALIGNMENT;
+	if (capacity < OUTPUT_DIRECT_ALIGNMENT)
+		capacity = OUTPUT_DIRECT_ALIGNMENT;
+
+	void *buffer = NULL;
+	if (0 != posix_memalign(&buffer, OUTPUT_DIRECT_ALIGNMENT, capacity)) {
+		close(output->fd);
+		return -1;
+	}
+	output->direct = buffer;
+	output->direct_capacity = capacity;
+
+	if (length > 0 && 0 != output_reserve(output, length)) {
+		free(output->direct);
+		close(output->fd);
+		return -1;
+	}
+
+	return 0;
+}
+
+int output_reserve(output_t *output, size_t length)
+{
+	if (NULL == output->direct || 0 == length)
+		return 0;
+
+	// Blocks are allocated up front; close trims what was not written
+	int status = posix_fallocate(output->fd, 0, length);
+	if (0 != status && EINVAL != status && EOPNOTSUPP != status)
+		return -1;
+
+	return 0;
+}
+
+ssize_t __output_direct_write(output_t *output, const unsigned char *data,
+			      size_t length)
+{
+	size_t written = 0;
+	while (written < length) {
+		ssize_t status = write(output->fd, data + written,
+				       length - written);
+		if (status < 0 && EINTR == errno)
+			continue;
+		if (status <= 0)
+			return -1;
+		written += status;
+	}
+
+	return written;
+}
+
+void __output_direct_flush(output_t *output)
+{
+	if (__output_direct_write(output, output->direct,
+				  output->direct_length) < 0)
+		output->failed = 1;
+	output->direct_length = 0;
+}
+
+int output_write(output_t *output, const unsigned char *data, size_t length)
+{
+	if (NULL != output->map) {
+		if (output->position > output->length
+		    || length > output->length - output->position)
+			return -1;
+		memcpy(output->map + output->position, data, length);
+	} else if (NULL != output->direct) {
+		for (size_t done = 0; done < length;) {
+			size_t size = output->direct_capacity -
+			    output->direct_length;
+			if (size > length - done)
+				size = length - done;
+			memcpy(output->direct + output->direct_length,
+			       data + done, size);
+			output->direct_length += size;
+			done += size;
+			if (output->direct_length == output->direct_capacity)
+				__output_direct_flush(output);
+		}
+	} else if (fwrite(data, 1, length, output->file) != length) {
+		return -1;
+	}
+
+	output->position += length;
+	return output->failed ? -1 : 0;
+}
+
+int __output_close_direct(output_t *output)
+{
+	int status = output->failed ? -1 : 0;
+
+	// The aligned head of the tail is written directly, the few bytes
+	// past the last boundary through the page cache.
+	size_t aligned = output->direct_length -
+	    output->direct_length % OUTPUT_DIRECT_ALIGNMENT;
+	if (aligned > 0
+	    && __output_direct_write(output, output->direct, aligned) < 0)
+		status = -1;
+
+	size_t tail = output->direct_length - aligned;
+	if (tail > 0) {
+		int flags = fcntl(output->fd, F_GETFL);
+#ifdef O_DIRECT
+		flags &= ~O_DIRECT;
+#endif
+		if (flags < 0 || 0 != fcntl(output->fd, F_SETFL, flags)
+		    || __output_direct_write(output, output->direct + aligned,
+					     tail) < 0)
+			status = -1;
+	}
+
+	// Drop the preallocated blocks past the end, and the tail page
+	if (0 != ftruncate(output->fd, output->position))
+		status = -1;
+	if (tail > 0) {
+		fdatasync(output->fd);
+		posix_fadvise(output->fd, 0, 0, POSIX_FADV_DONTNEED);
+	}
+
+	free(output->direct);
+	output->direct = NULL;
+	if (0 != close(output->fd))
+		status = -1;
+
+	return status;
+}
+
+int output_close(output_t *output)
+{
+	int status = output->failed ? -1 : 0;
+
+	// Caller-owned memory or stream: nothing to release
+	if (output->fd < 0) {
+		output->map = NULL;
+		if (NULL != output->file && 0 != fflush(output->file))
+			status = -1;
+		output->file = NULL;
+		return status;
+	}
+
+	if (NULL != output->direct)
+		return __output_close_direct(output);
+
+	if (NULL == output->map) {
+		if (NULL != output->file && 0 != fclose(output->file))
+			status = -1;
+		output->file = NULL;
+		return status;
+	}
+
+	if (0 != munmap(output->map, output->length))
+		status = -1;
+	output->map = NULL;
+
+	// A short (corrupted) input leaves the tail unwritten: do not keep
+	// the preallocated zeros around.
+	if (output->position < output->length
+	    && 0 != ftruncate(output->fd, output->position))
+		status = -1;
+
+	if (0 != close(output->fd))
+		status = -1;
+
+	return status;
+}
+
+unsigned char *output_region(output_t *output, size_t offset, size_t length)
+{
+	if (NULL == output->map || offset > output->length
+	    || length > output->length - offset)
+		return NULL;
+
+	return output->map + offset;
+}
+
+int output_is_mapped(const output_t *output)
+{
+	return NULL != output->map;
+}
+
+int output_is_direct(const output_t *output)
+{
+	if (NULL == output->direct)
+		return 0;
+
+#ifdef O_DIRECT
+	int flags = fcntl(output->fd, F_GETFL);
+	return flags >= 0 && (flags & O_DIRECT);
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,132 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "huffman/blocks.h"
+#include "huffman/codec.h"
+#include "huffman/histogram.h"
+#include "huffman/huffman.h"
+#include "huffman/plan.h"
+#include "huffman/statistics.h"
+#include "huffman/transform.h"
+
+long unsigned int __compress_plan_header_size(unsigned char filters,
+					      long unsigned int length,
+					      const frequency_t *table)
+{
+	long unsigned int size = HUFFMAN_MAGIC_SIZE + HUFFMAN_FILE_LENGTH_SIZE;
+	// Filters, and the number of symbols they produce
+	if (TRANSFORM_NONE != filters)
+		size += sizeof(filters) + sizeof(long unsigned int);
+	if (length > 0)
+		size += __blocks_table_size(table);
+
+	return size;
+}
+
+// Chooses the filters, counts the input from `start` to its end and sizes
+// the output; leaves `input` at `start`, and `codec` prepared for a single
+// stream
+int compress_plan(FILE *input, long start, compression_level_t level,
+		  unsigned char filters, codec_t *codec,
+		  compress_plan_t *plan)
+{
+	memset(plan, 0, sizeof(*plan));
+
+	if (0 != fseek(input, 0, SEEK_END))
+		return -1;
+	long length = ftell(input) - start;
+	if (length < 0 || 0 != fseek(input, start, SEEK_SET))
+		return -1;
+	plan->length = length;
+	plan->sampled = COMPRESSION_LEVEL_FAST == level
+	    && length >= HISTOGRAM_SAMPLE_THRESHOLD;
+
+	if (0 != frequencies_create(&plan->frequency_table))
+		return -1;
+
+	// The fast level samples the input, which the filters cannot: they
+	// are only selected at the normal level
+	bool automatic = TRANSFORM_AUTO == filters;
+	if (automatic)
+		filters = COMPRESSION_LEVEL_FAST == level ? TRANSFORM_NONE :
+		    transform_select(input, start, length);
+	if (0 == length)
+		filters = TRANSFORM_NONE;
+	plan->filters = filters;
+
+	// Exact counts of a large enough file may split it into blocks, also
+	// when the filters were chosen for it: the smaller output is kept
+	bool counted = false;
+	if ((TRANSFORM_NONE == filters || automatic)
+	    && COMPRESSION_LEVEL_NORMAL == level
+	    && blocks_eligible(input, length)) {
+		if (0 != blocks_count(input, start, length, codec,
+				      &plan->blocks, plan->frequency_table))
+			goto fail;
+		counted = TRANSFORM_NONE == filters;
+	}
+
+	if (TRANSFORM_NONE != filters) {
+		memset(plan->frequency_table, 0,
+		       HUFFMAN_MAX_SYMBOLS * sizeof(frequency_t));
+		if (0 != fseek(input, start, SEEK_SET)
+		    || 0 != __histogram_transformed(input, length, filters,
+						    plan->frequency_table))
+			goto fail;
+	} else if (!counted) {
+		if (0 != (COMPRESSION_LEVEL_FAST == level ?
+			  histogram_sample(input, start, length,
+					   plan->frequency_table) :
+			  histogram_count_range(input, start, length,
+						plan->frequency_table)))
+			goto fail;
+	}
+	if (0 != fseek(input, start, SEEK_SET))
+		goto fail;
+
+	plan->header_size = __compress_plan_header_size(filters, length,
+							plan->frequency_table);
+	plan->size = plan->header_size;
+	if (length > 0) {
+		if (0 != codec_prepare(codec, plan->frequency_table))
+			goto fail;
+		plan->size += codec_coded_size(codec, plan->frequency_table);
+	}
+
+	// Both sizes are exact, headers included
+	if (plan->blocks.count < 2
+	    || (TRANSFORM_NONE != filters && plan->blocks.size > plan->size)) {
+		blocks_destroy(&plan->blocks);
+		return 0;
+	}
+
+	if (TRANSFORM_NONE != filters) {
+		// Back to the counts of the unfiltered input
+		memset(plan->frequency_table, 0,
+		       HUFFMAN_MAX_SYMBOLS * sizeof(frequency_t));
+		for (unsigned int i = 0; i < plan->blocks.count; i++) {
+			for (int j = 0; j < HUFFMAN_MAX_SYMBOLS; j++) {
+				plan->frequency_table[j] +=
+				    plan->blocks.blocks[i].table[j];
+			}
+		}
+		plan->filters = TRANSFORM_NONE;
+		plan->header_size =
+		    __compress_plan_header_size(TRANSFORM_NONE, length,
+						plan->frequency_table);
+	}
+	plan->size = plan->blocks.size;
+
+	return 0;
+
+ fail:;
+	compress_plan_destroy(plan);
+	return -1;
+}
+
+void compress_plan_destroy(compress_plan_t *plan)
+{
+	blocks_destroy(&plan->blocks);
+	frequencies_destroy(&plan->frequency_table);
+}
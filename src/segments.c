@@ -0,0 +1,398 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "huffman/codec.h"
+#include "huffman/encoding_table.h"
+#include "huffman/huffman.h"
+#include "huffman/output.h"
+#include "huffman/plan.h"
+#include "huffman/segments.h"
+#include "huffman/statistics.h"
+#include "huffman/transform.h"
+
+// Reads the record ending at `end`, if it carries `magic`
+int __segments_record(FILE *file, long end, const char *magic,
+		      long unsigned int *offset, long unsigned int *length,
+		      unsigned int *count)
+{
+	char found[SEGMENTS_MAGIC_SIZE];
+	if (end < (long)SEGMENTS_TRAILER_SIZE
+	    || 0 != fseek(file, end - (long)SEGMENTS_TRAILER_SIZE, SEEK_SET)
+	    || fread(offset, sizeof(*offset), 1, file) != 1
+	    || fread(length, sizeof(*length), 1, file) != 1
+	    || fread(count, sizeof(*count), 1, file) != 1
+	    || fread(found, sizeof(char), SEGMENTS_MAGIC_SIZE, file) !=
+	    SEGMENTS_MAGIC_SIZE
+	    || 0 != memcmp(found, magic, SEGMENTS_MAGIC_SIZE))
+		return -1;
+
+	return 0;
+}
+
+// Reads the trailer ending at `end`, and checks that its segment starts
+// at the start of the file for the first one, past a previous trailer for
+// the others
+int __segments_trailer(FILE *file, long end, long unsigned int *offset,
+		       long unsigned int *length, unsigned int *count)
+{
+	if (0 != __segments_record(file, end, SEGMENTS_MAGIC, offset, length,
+				   count))
+		return -1;
+
+	long unsigned int segment_end = end - SEGMENTS_TRAILER_SIZE;
+	if (0 == *count || *offset >= segment_end
+	    || (1 == *count && 0 != *offset)
+	    || (*count > 1 && *offset < SEGMENTS_TRAILER_SIZE))
+		return -1;
+
+	return 0;
+}
+
+// Reads the count and length of the segments ending at `end` from the
+// last trailer only, or from the header of a single stream
+int __segments_tail(FILE *file, long end, segments_t *segments,
+		    bool *trailer)
+{
+	memset(segments, 0, sizeof(*segments));
+	segments->end = end;
+	*trailer = false;
+	if (0 == end)
+		return 0;
+
+	long unsigned int offset;
+	if (0 == __segments_trailer(file, end, &offset, &segments->length,
+				    &segments->count)) {
+		*trailer = true;
+		return 0;
+	}
+
+	stream_header_t header;
+	frequency_table_t frequency_table = NULL;
+	int status = -1;
+	if (0 == fseek(file, 0, SEEK_SET)
+	    && 0 == read_compressed_file(file, &header, &frequency_table)) {
+		segments->count = 1;
+		segments->length = header.file_length;
+		status = 0;
+	}
+	frequencies_destroy(&frequency_table);
+
+	return status;
+}
+
+// The end of what was appended: before the mark of an interrupted append,
+// if it agrees with what precedes it
+long __segments_end(FILE *file)
+{
+	if (0 != fseek(file, 0, SEEK_END))
+		return -1;
+	long size = ftell(file);
+
+	long unsigned int offset, length;
+	unsigned int count;
+	if (0 != __segments_record(file, size, SEGMENTS_PENDING, &offset,
+				   &length, &count)
+	    || offset > size - SEGMENTS_TRAILER_SIZE)
+		return size;
+
+	segments_t tail;
+	bool trailer;
+	if (0 != __segments_tail(file, offset, &tail, &trailer)
+	    || tail.count != count || tail.length != length)
+		return size;
+
+	return offset;
+}
+
+bool segments_present(FILE *file)
+{
+	long unsigned int offset, length;
+	unsigned int count;
+	if (0 != fseek(file, 0, SEEK_END))
+		return false;
+	long size = ftell(file);
+	long end = __segments_end(file);
+
+	return end >= 0 && (end < size
+			    || 0 == __segments_trailer(file, end, &offset,
+						       &length, &count));
+}
+
+// A file without trailer is a single stream, or nothing yet
+int __segments_open_stream(segments_t *segments, FILE *file, long end)
+{
+	if (0 == end)
+		return 0;
+
+	stream_header_t header;
+	frequency_table_t frequency_table = NULL;
+	int status = -1;
+	if (0 != fseek(file, 0, SEEK_SET)
+	    || 0 != read_compressed_file(file, &header, &frequency_table))
+		goto finalize;
+
+	segments->segments = malloc(sizeof(segment_t));
+	if (NULL == segments->segments)
+		goto finalize;
+
+	segments->segments[0].offset = 0;
+	segments->segments[0].length = header.file_length;
+	segments->count = 1;
+	segments->length = header.file_length;
+	segments->end = end;
+	status = 0;
+
+ finalize:;
+	frequencies_destroy(&frequency_table);
+	return status;
+}
+
+// Walks the trailers back from the one ending at `end`
+int __segments_open_chain(segments_t *segments, FILE *file, long end)
+{
+	long unsigned int offset, length;
+	unsigned int count;
+	if (0 != __segments_trailer(file, end, &offset, &length, &count)
+	    || count > end / SEGMENTS_TRAILER_SIZE)
+		return -1;
+
+	segments->segments = calloc(count, sizeof(segment_t));
+	if (NULL == segments->segments)
+		return -1;
+	segments->count = count;
+	segments->length = length;
+	segments->end = end;
+
+	for (unsigned int i = count; i > 1; i--) {
+		// The previous trailer ends where this segment starts
+		long unsigned int previous_offset, previous_length;
+		unsigned int previous_count;
+		if (0 != __segments_trailer(file, offset, &previous_offset,
+					    &previous_length, &previous_count)
+		    || previous_count != i - 1 || previous_length > length)
+			goto fail;
+
+		segments->segments[i - 1].offset = offset;
+		segments->segments[i - 1].length = length - previous_length;
+		offset = previous_offset;
+		length = previous_length;
+	}
+	segments->segments[0].offset = 0;
+	segments->segments[0].length = length;
+
+	return 0;
+
+ fail:;
+	segments_close(segments);
+	return -1;
+}
+
+int segments_open(segments_t *segments, FILE *file)
+{
+	memset(segments, 0, sizeof(*segments));
+
+	long end = __segments_end(file);
+	long unsigned int offset, length;
+	unsigned int count;
+	if (end < 0)
+		return -1;
+	if (0 != __segments_trailer(file, end, &offset, &length, &count))
+		return __segments_open_stream(segments, file, end);
+
+	return __segments_open_chain(segments, file, end);
+}
+
+int segments_decode(const segments_t *segments, FILE *file,
+		    output_t *output, codec_t *codec)
+{
+	for (unsigned int i = 0; i < segments->count; i++) {
+		const segment_t *segment = &segments->segments[i];
+		stream_header_t header;
+		frequency_table_t frequency_table = NULL;
+
+		int status = -1;
+		if (0 == fseek(file, segment->offset, SEEK_SET)
+		    && 0 == read_compressed_file(file, &header,
+						 &frequency_table)
+		    && header.file_length == segment->length
+		    && (0 == header.file_length
+			|| 0 == codec_prepare(codec, frequency_table)))
+			status = write_file(file, output, &header, codec);
+		frequencies_destroy(&frequency_table);
+
+		if (0 != status)
+			return -1;
+	}
+
+	return 0;
+}
+
+int __segments_write_record(FILE *output, const char *magic,
+			     long unsigned int offset,
+			     long unsigned int length, unsigned int count)
+{
+	fwrite(&offset, sizeof(offset), 1, output);
+	fwrite(&length, sizeof(length), 1, output);
+	fwrite(&count, sizeof(count), 1, output);
+	fwrite(magic, sizeof(char), SEGMENTS_MAGIC_SIZE, output);
+
+	return ferror(output) ? -1 : 0;
+}
+
+// Most bytes the planned segment can take: its size when the counts are
+// exact, else every symbol coded with the longest code
+long unsigned int __segments_bound(const compress_plan_t *plan,
+				   const codec_t *codec)
+{
+	if (!plan->sampled)
+		return plan->size;
+
+	unsigned int longest = 0;
+	for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++) {
+		if (0 == plan->frequency_table[i])
+			continue;
+		unsigned int length =
+		    encoding_length(codec->encoding_table[i]);
+		if (length > longest)
+			longest = length;
+	}
+
+	return plan->header_size + (plan->length * longest + 7) / 8;
+}
+
+int __segments_sync(FILE *output)
+{
+	return 0 == fflush(output) && 0 == fsync(fileno(output)) ? 0 : -1;
+}
+
+int segments_append(const char *filename, const char *output_filename,
+		    compression_level_t level, unsigned char filters,
+		    long unsigned int *appended)
+{
+	*appended = 0;
+
+	FILE *input = fopen(filename, "r");
+	if (NULL == input)
+		return -1;
+
+	FILE *output = fopen(output_filename, "r+");
+	if (NULL == output && ENOENT == errno)
+		output = fopen(output_filename, "w+");
+	if (NULL == output) {
+		fclose(input);
+		return -1;
+	}
+
+	// An interrupted append is dropped, up to the mark it left. Only the
+	// last trailer is read: appending does not depend on the count.
+	int status = -1;
+	long end = __segments_end(output);
+	if (end < 0 || 0 != fseek(output, 0, SEEK_END)
+	    || (end < ftell(output) && 0 != ftruncate(fileno(output), end)))
+		goto finalize;
+
+	segments_t segments;
+	bool trailer;
+	if (0 != __segments_tail(output, end, &segments, &trailer))
+		goto finalize;
+
+	// Only the bytes past the covered length are read. An input shorter
+	// than that was truncated or replaced, not appended to.
+	struct stat info;
+	if (0 != fstat(fileno(input), &info)
+	    || (long unsigned int)info.st_size < segments.length)
+		goto finalize;
+
+	if ((long unsigned int)info.st_size == segments.length
+	    && segments.count > 0) {
+		status = 0;
+		goto finalize;
+	}
+
+	// compress_plan measures the input once and compress_planned reads
+	// no further, so the segment covers `plan.length` bytes even if the
+	// input grows meanwhile
+	codec_t codec;
+	codec_create(&codec);
+	compress_plan_t plan;
+	if (0 != compress_plan(input, segments.length, level, filters, &codec,
+			       &plan))
+		goto finalize_codec;
+
+	// A single stream first gets the trailer it lacks
+	long unsigned int offset = end;
+	if (segments.count > 0 && !trailer)
+		offset += SEGMENTS_TRAILER_SIZE;
+
+	// The mark reaches the disk before the segment
+	long unsigned int bound = __segments_bound(&plan, &codec);
+	if (0 != fseek(output, offset + bound, SEEK_SET)
+	    || 0 != __segments_write_record(output, SEGMENTS_PENDING, end,
+					    segments.length, segments.count)
+	    || 0 != __segments_sync(output))
+		goto finalize_truncate;
+
+	if (0 != fseek(output, end, SEEK_SET)
+	    || (offset > (long unsigned int)end
+		&& 0 != __segments_write_record(output, SEGMENTS_MAGIC, 0,
+						segments.length, 1)))
+		goto finalize_truncate;
+
+	output_t stream;
+	output_open_stream(&stream, output);
+	status = compress_planned(input, &stream, segments.length, &plan,
+				  &codec);
+	if (0 != output_close(&stream))
+		status = -1;
+	long segment_end = ftell(output);
+	if (0 != status || segment_end < 0
+	    || (long unsigned int)segment_end - offset > bound
+	    || 0 != __segments_sync(output)) {
+		status = -1;
+		goto finalize_truncate;
+	}
+
+	// The trailer reaches the disk before the mark is cut off: when the
+	// bound was exact, it replaces the mark
+	status = -1;
+	if (0 != __segments_write_record(output, SEGMENTS_MAGIC, offset,
+					 segments.length + plan.length,
+					 segments.count + 1)
+	    || 0 != __segments_sync(output)
+	    || 0 != ftruncate(fileno(output),
+			      segment_end + SEGMENTS_TRAILER_SIZE))
+		goto finalize_truncate;
+
+	*appended = plan.length;
+	status = 0;
+
+ finalize_truncate:;
+	// A failed append leaves the file as it was
+	if (0 != status) {
+		fflush(output);
+		if (0 != ftruncate(fileno(output), end))
+			status = -1;
+	}
+	compress_plan_destroy(&plan);
+ finalize_codec:;
+	codec_destroy(&codec);
+ finalize:;
+	fclose(input);
+	if (0 != fclose(output))
+		status = -1;
+
+	return status;
+}
+
+void segments_close(segments_t *segments)
+{
+	free(segments->segments);
+	memset(segments, 0, sizeof(*segments));
+}
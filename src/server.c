@@ -0,0 +1,620 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "huffman/codec.h"
+#include "huffman/histogram.h"
+#include "huffman/memory.h"
+#include "huffman/output.h"
+#include "huffman/server.h"
+#include "huffman/statistics.h"
+
+// Header, symbol count and a full frequency table
+#define SERVER_HEADER_BOUND \
+	(HUFFMAN_MAGIC_SIZE + HUFFMAN_FILE_LENGTH_SIZE + \
+	 HUFFMAN_SYMBOL_COUNT_SIZE + \
+	 HUFFMAN_MAX_SYMBOLS * (HUFFMAN_SYMBOL_SIZE + HUFFMAN_FREQUENCY_SIZE))
+
+double __server_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+// Returns 0 once `length` bytes are read, 1 on end of stream before the
+// first byte, and -1 on error.
+int __server_read(int fd, void *buffer, size_t length)
+{
+	size_t done = 0;
+	while (done < length) {
+		ssize_t count = read(fd, (char *)buffer + done, length - done);
+		if (count < 0 && EINTR == errno)
+			continue;
+		if (count < 0)
+			return -1;
+		if (0 == count)
+			return 0 == done ? 1 : -1;
+		done += count;
+	}
+
+	return 0;
+}
+
+int __server_write(int fd, const void *buffer, size_t length)
+{
+	size_t done = 0;
+	while (done < length) {
+		ssize_t count = send(fd, (const char *)buffer + done,
+				     length - done, MSG_NOSIGNAL);
+		if (count < 0 && EINTR == errno)
+			continue;
+		if (count <= 0)
+			return -1;
+		done += count;
+	}
+
+	return 0;
+}
+
+// Largest payload a worker accepts, in either direction
+uint64_t __server_max_payload(const server_t *server)
+{
+	// Without a limit, the workers share half of the physical memory
+	const memory_plan_t *plan = memory_plan();
+	size_t thread_limit = plan->thread_limit;
+	if (0 == plan->limit) {
+		thread_limit = memory_physical() / 2;
+		if (0 == thread_limit)
+			return SERVER_MAX_PAYLOAD;
+		if (server->worker_count > 1)
+			thread_limit /= server->worker_count;
+	}
+
+	// Input and output buffers share what the thread is given
+	size_t share = thread_limit / 2;
+	if (share > SERVER_HEADER_BOUND + plan->buffer_size)
+		share -= SERVER_HEADER_BOUND + plan->buffer_size;
+
+	return share < SERVER_MAX_PAYLOAD ? share : SERVER_MAX_PAYLOAD;
+}
+
+int __server_reserve(const server_t *server, unsigned char **buffer,
+		     size_t *capacity, size_t length)
+{
+	if (length <= *capacity)
+		return 0;
+
+	// Grow geometrically so that a worker settles on its working size,
+	// unless memory is limited or that would pass the largest payload
+	size_t size = *capacity > 0 ? *capacity : 4096;
+	while (size < length) {
+		size *= 2;
+	}
+	if (0 != memory_plan()->limit
+	    || size > __server_max_payload(server) + SERVER_HEADER_BOUND + 1)
+		size = length;
+
+	unsigned char *grown = realloc(*buffer, size);
+	if (NULL == grown)
+		return -1;
+
+	*buffer = grown;
+	*capacity = size;
+	return 0;
+}
+
+void __server_record(server_t *server, double latency)
+{
+	pthread_mutex_lock(&server->latency_lock);
+	server->latencies[server->latency_count % SERVER_LATENCY_SAMPLES] =
+	    latency;
+	server->latency_count++;
+	pthread_mutex_unlock(&server->latency_lock);
+}
+
+int __server_compare_latency(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+void server_latency(server_t *server, server_latency_t *latency)
+{
+	static double samples[SERVER_LATENCY_SAMPLES];
+	static pthread_mutex_t samples_lock = PTHREAD_MUTEX_INITIALIZER;
+
+	memset(latency, 0, sizeof(*latency));
+	pthread_mutex_lock(&samples_lock);
+
+	pthread_mutex_lock(&server->latency_lock);
+	latency->count = server->latency_count;
+	size_t count = latency->count < SERVER_LATENCY_SAMPLES ?
+	    latency->count : SERVER_LATENCY_SAMPLES;
+	memcpy(samples, server->latencies, count * sizeof(double));
+	pthread_mutex_unlock(&server->latency_lock);
+
+	if (count > 0) {
+		qsort(samples, count, sizeof(double),
+		      __server_compare_latency);
+		latency->p50 = samples[(size_t)(0.5 * (count - 1))];
+		latency->p90 = samples[(size_t)(0.9 * (count - 1))];
+		latency->p99 = samples[(size_t)(0.99 * (count - 1))];
+		latency->p999 = samples[(size_t)(0.999 * (count - 1))];
+		latency->max = samples[count - 1];
+	}
+
+	pthread_mutex_unlock(&samples_lock);
+}
+
+server_status_t __server_compress(server_worker_t *worker, size_t length,
+				  size_t *response_length)
+{
+	// Huffman codes never do worse than 8 bits per byte on exact counts
+	size_t bound = SERVER_HEADER_BOUND + length + 1;
+	if (0 != __server_reserve(worker->server, &worker->output,
+				  &worker->output_capacity, bound))
+		return SERVER_ERROR_MEMORY;
+
+	FILE *output = fmemopen(worker->output, bound, "w");
+	if (NULL == output)
+		return SERVER_ERROR_MEMORY;
+
+	int status = 0;
+	if (0 == length) {
+		status = write_header(output, 0, NULL);
+	} else {
+		FILE *input = fmemopen(worker->input, length, "r");
+		if (NULL == input) {
+			fclose(output);
+			return SERVER_ERROR_MEMORY;
+		}
+
+		// No filters: they could expand the payload past the bound
+		status = compress_stream(input, output,
+					 COMPRESSION_LEVEL_NORMAL,
+					 TRANSFORM_NONE, &worker->encoder);
+		fclose(input);
+	}
+
+	fflush(output);
+	*response_length = ftell(output);
+	fclose(output);
+
+	return 0 == status ? SERVER_OK : SERVER_ERROR_PAYLOAD;
+}
+
+server_status_t __server_decompress(server_worker_t *worker, size_t length,
+				    size_t *response_length)
+{
+	if (0 == length)
+		return SERVER_ERROR_PAYLOAD;
+
+	FILE *input = fmemopen(worker->input, length, "r");
+	if (NULL == input)
+		return SERVER_ERROR_MEMORY;
+
+	server_status_t status = SERVER_ERROR_PAYLOAD;
+	stream_header_t header;
+	frequency_table_t frequency_table = NULL;
+
+	if (0 != read_compressed_file(input, &header, &frequency_table))
+		goto finalize;
+
+	if (header.file_length > __server_max_payload(worker->server)) {
+		status = SERVER_ERROR_MEMORY;
+		goto finalize;
+	}
+
+	if (0 != __server_reserve(worker->server, &worker->output,
+				  &worker->output_capacity,
+				  header.file_length)) {
+		status = SERVER_ERROR_MEMORY;
+		goto finalize;
+	}
+
+	output_t output;
+	output_open_buffer(&output, worker->output, header.file_length);
+	if ((0 == header.file_length
+	     || 0 == codec_prepare(&worker->decoder, frequency_table))
+	    && 0 == write_file(input, &output, &header, &worker->decoder))
+		status = SERVER_OK;
+	*response_length = output.position;
+	if (0 != output_close(&output))
+		status = SERVER_ERROR_PAYLOAD;
+
+ finalize:;
+	frequencies_destroy(&frequency_table);
+	fclose(input);
+
+	return status;
+}
+
+server_status_t __server_stats(server_worker_t *worker,
+			       size_t *response_length)
+{
+	server_latency_t latency;
+	server_latency(worker->server, &latency);
+
+	if (0 != __server_reserve(worker->server, &worker->output,
+				  &worker->output_capacity, 512))
+		return SERVER_ERROR_MEMORY;
+
+	*response_length =
+	    snprintf((char *)worker->output, 512,
+		     "requests %lu\np50_us %.1f\np90_us %.1f\np99_us %.1f\n"
+		     "p999_us %.1f\nmax_us %.1f\n", latency.count,
+		     latency.p50, latency.p90, latency.p99, latency.p999,
+		     latency.max);
+
+	return SERVER_OK;
+}
+
+int __server_discard(server_worker_t *worker, int fd, uint64_t length)
+{
+	if (0 != __server_reserve(worker->server, &worker->input,
+				  &worker->input_capacity,
+				  memory_plan()->buffer_size))
+		return -1;
+
+	while (length > 0) {
+		size_t chunk = length < worker->input_capacity ?
+		    length : worker->input_capacity;
+		if (0 != __server_read(fd, worker->input, chunk))
+			return -1;
+		length -= chunk;
+	}
+
+	return 0;
+}
+
+server_status_t __server_handle(server_worker_t *worker,
+				const server_request_t *request,
+				size_t *response_length)
+{
+	switch (request->operation) {
+	case SERVER_COMPRESS:
+		return __server_compress(worker, request->length,
+					 response_length);
+	case SERVER_DECOMPRESS:
+		return __server_decompress(worker, request->length,
+					   response_length);
+	case SERVER_STATS:
+		return __server_stats(worker, response_length);
+	default:
+		return SERVER_ERROR_OPERATION;
+	}
+}
+
+// Serves one request from a readable connection; returns -1 once the
+// connection is closed or unusable
+int __server_serve(server_worker_t *worker, int fd)
+{
+	server_t *server = worker->server;
+
+	server_request_t request;
+	if (0 != __server_read(fd, &request, sizeof(request)))
+		return -1;
+
+	double start = __server_now();
+	server_response_t response = {.status = SERVER_OK,.flags = 0,.length =
+		    0
+	};
+	size_t response_length = 0;
+
+	if (request.length > __server_max_payload(worker->server)) {
+		// Refuse the request but keep the connection usable
+		if (0 != __server_discard(worker, fd, request.length))
+			return -1;
+		response.status = SERVER_ERROR_MEMORY;
+	} else if (0 != __server_reserve(worker->server, &worker->input,
+					 &worker->input_capacity,
+					 request.length)
+		   || (request.length > 0
+		       && 0 != __server_read(fd, worker->input,
+					     request.length))) {
+		return -1;
+	} else {
+		response.status = __server_handle(worker, &request,
+						  &response_length);
+	}
+
+	if (SERVER_OK != response.status)
+		response_length = 0;
+	response.length = response_length;
+
+	if (0 != __server_write(fd, &response, sizeof(response))
+	    || 0 != __server_write(fd, worker->output, response_length))
+		return -1;
+
+	__server_record(server, __server_now() - start);
+	return 0;
+}
+
+int __server_pop(server_t *server)
+{
+	pthread_mutex_lock(&server->lock);
+	while (0 == server->pending_count && !server->stopping) {
+		pthread_cond_wait(&server->ready, &server->lock);
+	}
+
+	int fd = -1;
+	if (server->pending_count > 0) {
+		fd = server->pending[server->pending_head];
+		server->pending_head = (server->pending_head + 1) %
+		    SERVER_BACKLOG;
+		server->pending_count--;
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	return fd;
+}
+
+void *__server_work(void *argument)
+{
+	server_worker_t *worker = argument;
+
+	server_t *server = worker->server;
+
+	int fd;
+	while ((fd = __server_pop(server)) >= 0) {
+		if (0 != __server_serve(worker, fd)) {
+			close(fd);
+			fd = -1;
+		}
+
+		// The pipe never fills: it holds at most one descriptor per
+		// connection, and there are at most SERVER_BACKLOG of them
+		ssize_t written = write(server->returned[1], &fd, sizeof(fd));
+		if ((ssize_t)sizeof(fd) != written && fd >= 0)
+			close(fd);
+	}
+
+	return NULL;
+}
+
+void __server_wake(server_t *server)
+{
+	pthread_mutex_lock(&server->lock);
+	pthread_cond_broadcast(&server->ready);
+	pthread_mutex_unlock(&server->lock);
+}
+
+int server_create(server_t *server, const char *path, int worker_count)
+{
+	memset(server, 0, sizeof(*server));
+	server->fd = -1;
+	server->returned[0] = -1;
+	server->returned[1] = -1;
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path))
+		return -1;
+	strcpy(address.sun_path, path);
+
+	server->path = malloc(strlen(path) + 1);
+	if (NULL == server->path)
+		return -1;
+	strcpy(server->path, path);
+
+	server->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server->fd < 0)
+		goto fail;
+
+	// Replace a stale socket, but never another kind of file
+	struct stat status;
+	if (0 == lstat(path, &status)) {
+		if (!S_ISSOCK(status.st_mode)) {
+			errno = EEXIST;
+			goto fail;
+		}
+		unlink(path);
+	}
+
+	if (0 != bind(server->fd, (struct sockaddr *)&address,
+		      sizeof(address))
+	    || 0 != listen(server->fd, SERVER_BACKLOG))
+		goto fail;
+
+	pthread_mutex_init(&server->lock, NULL);
+	pthread_cond_init(&server->ready, NULL);
+	pthread_mutex_init(&server->latency_lock, NULL);
+
+	if (0 != pipe(server->returned)
+	    || 0 != fcntl(server->returned[0], F_SETFL, O_NONBLOCK))
+		goto fail_threads;
+
+	server->workers = calloc(worker_count, sizeof(server_worker_t));
+	if (NULL == server->workers)
+		goto fail_threads;
+
+	for (int i = 0; i < worker_count; i++) {
+		server_worker_t *worker = &server->workers[i];
+		worker->server = server;
+		codec_create(&worker->encoder);
+		codec_create(&worker->decoder);
+
+		if (0 != pthread_create(&worker->thread, NULL, __server_work,
+					worker))
+			goto fail_threads;
+		server->worker_count++;
+	}
+
+	return 0;
+
+ fail_threads:;
+	server_destroy(server);
+	return -1;
+
+ fail:;
+	if (server->fd >= 0)
+		close(server->fd);
+	server->fd = -1;
+	free(server->path);
+	server->path = NULL;
+	return -1;
+}
+
+void __server_idle(server_t *server, int fd)
+{
+	struct pollfd *pfd = &server->polled[2 + server->idle_count++];
+	pfd->fd = fd;
+	pfd->events = POLLIN;
+	pfd->revents = 0;
+}
+
+// Takes back the connections that workers are done with
+void __server_collect(server_t *server)
+{
+	int fd;
+	while ((ssize_t)sizeof(fd) ==
+	       read(server->returned[0], &fd, sizeof(fd))) {
+		if (fd >= 0)
+			__server_idle(server, fd);
+		else
+			server->connection_count--;
+	}
+}
+
+// Queues the idle connections with a request, or a hangup, to read
+void __server_dispatch(server_t *server)
+{
+	struct pollfd *idle = &server->polled[2];
+	size_t kept = 0;
+
+	pthread_mutex_lock(&server->lock);
+	for (size_t i = 0; i < server->idle_count; i++) {
+		if (0 == idle[i].revents) {
+			idle[kept++] = idle[i];
+			continue;
+		}
+
+		// Never full: the queue holds every connection there can be
+		server->pending[(server->pending_head + server->pending_count)
+				% SERVER_BACKLOG] = idle[i].fd;
+		server->pending_count++;
+		pthread_cond_signal(&server->ready);
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	server->idle_count = kept;
+}
+
+void __server_accept(server_t *server)
+{
+	int fd = accept(server->fd, NULL, NULL);
+	if (fd < 0)
+		return;
+
+	// A client stalling in the middle of a request only holds its
+	// worker for so long
+	struct timeval timeout = {
+		.tv_sec = SERVER_IO_TIMEOUT / 1000,
+		.tv_usec = SERVER_IO_TIMEOUT % 1000 * 1000
+	};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	__server_idle(server, fd);
+	server->connection_count++;
+}
+
+int server_run(server_t *server)
+{
+	server->polled[0].fd = server->fd;
+	server->polled[1].fd = server->returned[0];
+	server->polled[1].events = POLLIN;
+
+	while (!server->stopping) {
+		// Stop accepting while every slot is taken
+		server->polled[0].events =
+		    server->connection_count < SERVER_BACKLOG ? POLLIN : 0;
+
+		int ready = poll(server->polled, 2 + server->idle_count,
+				 SERVER_POLL_INTERVAL);
+		if (ready < 0 && EINTR != errno)
+			return -1;
+		if (ready <= 0)
+			continue;
+
+		__server_dispatch(server);
+		if (server->polled[1].revents)
+			__server_collect(server);
+		if (server->polled[0].revents)
+			__server_accept(server);
+	}
+
+	return 0;
+}
+
+void server_stop(server_t *server)
+{
+	// Only sets the flag: safe to call from a signal handler
+	server->stopping = 1;
+}
+
+void server_destroy(server_t *server)
+{
+	server->stopping = 1;
+	__server_wake(server);
+
+	for (int i = 0; i < server->worker_count; i++) {
+		server_worker_t *worker = &server->workers[i];
+		pthread_join(worker->thread, NULL);
+		free(worker->input);
+		free(worker->output);
+		codec_destroy(&worker->encoder);
+		codec_destroy(&worker->decoder);
+	}
+	free(server->workers);
+	server->workers = NULL;
+	server->worker_count = 0;
+
+	while (server->pending_count > 0) {
+		close(server->pending[server->pending_head]);
+		server->pending_head = (server->pending_head + 1) %
+		    SERVER_BACKLOG;
+		server->pending_count--;
+	}
+
+	// Workers are gone: close what they handed back and what was idle
+	if (server->returned[0] >= 0)
+		__server_collect(server);
+	for (size_t i = 0; i < server->idle_count; i++) {
+		close(server->polled[2 + i].fd);
+	}
+	server->idle_count = 0;
+	server->connection_count = 0;
+	for (int i = 0; i < 2; i++) {
+		if (server->returned[i] >= 0)
+			close(server->returned[i]);
+		server->returned[i] = -1;
+	}
+
+	pthread_mutex_destroy(&server->lock);
+	pthread_cond_destroy(&server->ready);
+	pthread_mutex_destroy(&server->latency_lock);
+
+	close(server->fd);
+	server->fd = -1;
+	unlink(server->path);
+	free(server->path);
+	server->path = NULL;
+}
@@ -0,0 +1,327 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "huffman/huffman.h"
+#include "huffman/transform.h"
+
+static const struct {
+	const char *name;
+	unsigned char filter;
+} transform_filters[] = {
+	{"delta", TRANSFORM_DELTA},
+	{"mtf", TRANSFORM_MTF},
+	{"rle", TRANSFORM_RLE}
+};
+
+#define TRANSFORM_FILTER_COUNT \
+	(sizeof(transform_filters) / sizeof(transform_filters[0]))
+
+int transform_parse(const char *names, unsigned char *filters)
+{
+	if (0 == strcmp(names, "auto")) {
+		*filters = TRANSFORM_AUTO;
+		return 0;
+	}
+
+	*filters = TRANSFORM_NONE;
+	if (0 == strcmp(names, "none"))
+		return 0;
+
+	// Comma-separated list, in any order
+	while ('\0' != *names) {
+		size_t length = strcspn(names, ",");
+		bool found = false;
+
+		for (size_t i = 0; i < TRANSFORM_FILTER_COUNT; i++) {
+			if (strlen(transform_filters[i].name) == length
+			    && 0 == strncmp(names, transform_filters[i].name,
+					    length)) {
+				*filters |= transform_filters[i].filter;
+				found = true;
+			}
+		}
+
+		if (!found)
+			return -1;
+
+		names += length;
+		if (',' == *names)
+			names++;
+	}
+
+	return 0;
+}
+
+void transform_names(unsigned char filters, char *buffer, size_t size)
+{
+	if (0 == size)
+		return;
+
+	buffer[0] = '\0';
+	if (TRANSFORM_NONE == filters) {
+		snprintf(buffer, size, "none");
+		return;
+	}
+
+	size_t used = 0;
+	for (size_t i = 0; i < TRANSFORM_FILTER_COUNT && used < size; i++) {
+		if (filters & transform_filters[i].filter)
+			used += snprintf(buffer + used, size - used, "%s%s",
+					 0 == used ? "" : ",",
+					 transform_filters[i].name);
+	}
+}
+
+void transform_create(transform_t *transform, unsigned char filters)
+{
+	transform->filters = filters & TRANSFORM_ALL;
+	transform->previous = 0;
+	for (int i = 0; i < 256; i++) {
+		transform->order[i] = i;
+	}
+	transform->run_symbol = -1;
+	transform->run_length = 0;
+	transform->run_count = 0;
+	transform->run_counting = false;
+}
+
+size_t transform_bound(size_t length)
+{
+	// RLE adds at most one count byte per pair of input bytes
+	return length + length / 2 + 2;
+}
+
+size_t transform_forward(transform_t *transform, const unsigned char *input,
+			 size_t length, unsigned char *output)
+{
+	size_t written = 0;
+
+	for (size_t i = 0; i < length; i++) {
+		unsigned char byte = input[i];
+
+		if (transform->filters & TRANSFORM_DELTA) {
+			unsigned char delta =
+			    (unsigned char)(byte - transform->previous);
+			transform->previous = byte;
+			byte = delta;
+		}
+
+		if (transform->filters & TRANSFORM_MTF) {
+			unsigned char index = 0;
+			while (transform->order[index] != byte) {
+				index++;
+			}
+			for (unsigned char j = index; j > 0; j--) {
+				transform->order[j] = transform->order[j - 1];
+			}
+			transform->order[0] = byte;
+			byte = index;
+		}
+
+		if (!(transform->filters & TRANSFORM_RLE)) {
+			output[written++] = byte;
+			continue;
+		}
+
+		if (transform->run_counting) {
+			if (byte == transform->run_symbol
+			    && transform->run_count < TRANSFORM_RLE_MAX) {
+				transform->run_count++;
+				continue;
+			}
+
+			output[written++] = transform->run_count;
+			transform->run_counting = false;
+			transform->run_symbol = -1;
+			transform->run_length = 0;
+		}
+
+		output[written++] = byte;
+		if (byte == transform->run_symbol) {
+			transform->run_length++;
+		} else {
+			transform->run_symbol = byte;
+			transform->run_length = 1;
+		}
+
+		if (TRANSFORM_RLE_RUN == transform->run_length) {
+			transform->run_counting = true;
+			transform->run_count = 0;
+		}
+	}
+
+	return written;
+}
+
+size_t transform_flush(transform_t *transform, unsigned char *output)
+{
+	if (!transform->run_counting)
+		return 0;
+
+	output[0] = transform->run_count;
+	transform->run_counting = false;
+	transform->run_symbol = -1;
+	transform->run_length = 0;
+
+	return 1;
+}
+
+double __transform_cost(const frequency_t *table, double scale)
+{
+	frequency_t total = 0;
+	int symbols = 0;
+	for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++) {
+		total += table[i];
+		symbols += 0 != table[i];
+	}
+
+	double bits = 0;
+	for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++) {
+		if (0 != table[i])
+			bits += table[i] * log2((double)total / table[i]);
+	}
+
+	// Order-0 entropy of the whole stream, plus its frequency table
+	return bits / 8 * scale +
+	    symbols * (HUFFMAN_SYMBOL_SIZE + HUFFMAN_FREQUENCY_SIZE);
+}
+
+unsigned char transform_select(FILE *file, long start, long length)
+{
+	if (length <= 0)
+		return TRANSFORM_NONE;
+
+	size_t size = TRANSFORM_SAMPLE_CHUNK_SIZE;
+	unsigned char *sample = malloc(size);
+	unsigned char *transformed = malloc(transform_bound(size));
+	frequency_t *tables = calloc(TRANSFORM_ALL + 1,
+				     HUFFMAN_MAX_SYMBOLS * sizeof(frequency_t));
+	unsigned char selected = TRANSFORM_NONE;
+	if (NULL == sample || NULL == transformed || NULL == tables)
+		goto finalize;
+
+	// Small inputs are sampled whole, larger ones by strided chunks
+	int chunks = (long)(TRANSFORM_SAMPLE_CHUNKS * size) >= length ?
+	    (int)((length + size - 1) / size) : TRANSFORM_SAMPLE_CHUNKS;
+	long stride = length / chunks;
+	long sampled = 0;
+
+	for (int k = 0; k < chunks; k++) {
+		if (0 != fseek(file, start + k * stride, SEEK_SET))
+			goto finalize;
+		size_t read = fread(sample, 1, size, file);
+		sampled += read;
+
+		for (int filters = 0; filters <= TRANSFORM_ALL; filters++) {
+			transform_t transform;
+			transform_create(&transform, filters);
+			size_t count = transform_forward(&transform, sample,
+							 read, transformed);
+			count += transform_flush(&transform,
+						 transformed + count);
+
+			frequency_t *table =
+			    tables + filters * HUFFMAN_MAX_SYMBOLS;
+			for (size_t i = 0; i < count; i++) {
+				table[transformed[i]]++;
+			}
+		}
+	}
+
+	if (0 == sampled)
+		goto finalize;
+
+	double scale = (double)length / sampled;
+	double best = __transform_cost(tables, scale);
+	double threshold = best * (1 - TRANSFORM_SAMPLE_MARGIN);
+	for (int filters = 1; filters <= TRANSFORM_ALL; filters++) {
+		double cost = __transform_cost(tables +
+					       filters * HUFFMAN_MAX_SYMBOLS,
+					       scale);
+		if (cost < threshold && cost < best) {
+			best = cost;
+			selected = filters;
+		}
+	}
+
+ finalize:;
+	free(sample);
+	free(transformed);
+	free(tables);
+	fseek(file, start, SEEK_SET);
+
+	return selected;
+}
+
+int transform_reader_create(transform_reader_t *reader, FILE *file,
+			    long unsigned int length, unsigned char filters,
+			    size_t size)
+{
+	reader->file = file;
+	reader->remaining = length;
+	transform_create(&reader->transform, filters);
+	reader->raw_size = size;
+	reader->raw = malloc(size);
+	reader->buffer = NULL;
+	reader->finished = false;
+
+	if (TRANSFORM_NONE != reader->transform.filters)
+		reader->buffer = malloc(transform_bound(size));
+
+	// GCOV_EXCL_START
+	if (NULL == reader->raw
+	    || (TRANSFORM_NONE != reader->transform.filters
+		&& NULL == reader->buffer)) {
+		transform_reader_destroy(reader);
+		return -1;
+	}
+	// GCOV_EXCL_STOP
+
+	return 0;
+}
+
+size_t transform_reader_read(transform_reader_t *reader,
+			     const unsigned char **data)
+{
+	if (reader->finished)
+		return 0;
+
+	// Reads stop after `length` bytes, even if the file grew meanwhile
+	size_t size = reader->remaining < reader->raw_size ?
+	    (size_t)reader->remaining : reader->raw_size;
+	size_t length = 0 == size ? 0 : fread(reader->raw, 1, size,
+					     reader->file);
+	reader->remaining -= length;
+
+	if (TRANSFORM_NONE == reader->transform.filters) {
+		*data = reader->raw;
+		reader->finished = 0 == length;
+		return length;
+	}
+
+	size_t count = transform_forward(&reader->transform, reader->raw,
+					 length, reader->buffer);
+	if (0 == length) {
+		count += transform_flush(&reader->transform,
+					 reader->buffer + count);
+		reader->finished = true;
+	}
+
+	*data = reader->buffer;
+	// A block may shrink to nothing (inside a run): read on
+	if (0 == count && !reader->finished)
+		return transform_reader_read(reader, data);
+
+	return count;
+}
+
+void transform_reader_destroy(transform_reader_t *reader)
+{
+	free(reader->raw);
+	free(reader->buffer);
+	reader->raw = NULL;
+	reader->buffer = NULL;
+}
@@ -0,0 +1,130 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "huffman/bitstream.h"
+
+#define BENCH_CODES (32L * 1024 * 1024)
+#define BENCH_MAX_LENGTH 16
+
+static double bench_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void bench_report(const char *name, double elapsed, long bytes)
+{
+	printf("%-24s %8.3fs %10.1f MB/s\n", name, elapsed,
+	       bytes / elapsed / 1e6);
+}
+
+// Reference: the former one-bit-at-a-time writer with 1-byte fwrite
+static long bench_write_bytewise(FILE *file, const uint16_t *codes,
+				 const unsigned char *lengths)
+{
+	char buffer = 0;
+	int buffer_length = 0;
+
+	for (long i = 0; i < BENCH_CODES; i++) {
+		for (int j = lengths[i] - 1; j >= 0; j--) {
+			buffer = (buffer << 1) | ((codes[i] >> j) & 0x1);
+			buffer_length++;
+
+			if (buffer_length == 8) {
+				fwrite(&buffer, sizeof(buffer), 1, file);
+				buffer = 0;
+				buffer_length = 0;
+			}
+		}
+	}
+
+	if (buffer_length > 0) {
+		buffer = buffer << (8 - buffer_length);
+		fwrite(&buffer, sizeof(char), 1, file);
+	}
+
+	return ftell(file);
+}
+
+static long bench_write(FILE *file, const uint16_t *codes,
+			const unsigned char *lengths)
+{
+	bit_writer_t writer;
+	bit_writer_create(&writer, file);
+
+	for (long i = 0; i < BENCH_CODES; i++) {
+		bit_writer_put(&writer, codes[i], lengths[i]);
+	}
+
+	bit_writer_flush(&writer);
+	bit_writer_destroy(&writer);
+
+	return ftell(file);
+}
+
+static uint64_t bench_read(FILE *file, const unsigned char *lengths)
+{
+	bit_reader_t reader;
+	bit_reader_create(&reader, file);
+
+	uint64_t checksum = 0;
+	for (long i = 0; i < BENCH_CODES; i++) {
+		checksum += bit_reader_read(&reader, lengths[i]);
+	}
+
+	bit_reader_destroy(&reader);
+
+	return checksum;
+}
+
+int main(void)
+{
+	uint16_t *codes = malloc(BENCH_CODES * sizeof(uint16_t));
+	unsigned char *lengths = malloc(BENCH_CODES);
+	if (NULL == codes || NULL == lengths)
+		return EXIT_FAILURE;
+
+	uint64_t expected = 0;
+	srand(42);
+	for (long i = 0; i < BENCH_CODES; i++) {
+		lengths[i] = 1 + rand() % BENCH_MAX_LENGTH;
+		codes[i] = rand() & ((1 << lengths[i]) - 1);
+		expected += codes[i];
+	}
+
+	printf("Bitstream: %ld codes of 1 to %d bits\n", BENCH_CODES,
+	       BENCH_MAX_LENGTH);
+
+	FILE *file = tmpfile();
+	double start = bench_now();
+	long bytes = bench_write_bytewise(file, codes, lengths);
+	bench_report("write (bit by bit)", bench_now() - start, bytes);
+	fclose(file);
+
+	file = tmpfile();
+	start = bench_now();
+	bytes = bench_write(file, codes, lengths);
+	bench_report("write (bit_writer)", bench_now() - start, bytes);
+
+	rewind(file);
+	start = bench_now();
+	uint64_t checksum = bench_read(file, lengths);
+	bench_report("read (bit_reader)", bench_now() - start, bytes);
+	fclose(file);
+
+	free(codes);
+	free(lengths);
+
+	if (checksum != expected) {
+		fprintf(stderr, "Checksum mismatch\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,142 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "huffman/codec.h"
+#include "huffman/histogram.h"
+#include "huffman/statistics.h"
+#include "huffman/transform.h"
+
+#define BENCH_SIZE (128L * 1024 * 1024)
+
+static double bench_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void bench_report(const char *name, double elapsed, long bytes)
+{
+	printf("%-24s %8.3fs %10.1f MB/s\n", name, elapsed,
+	       bytes / elapsed / 1e6);
+}
+
+static FILE *bench_encode(const char *name, FILE *input, codec_t *codec)
+{
+	FILE *output = tmpfile();
+	rewind(input);
+
+	double start = bench_now();
+	if (0 != encode_file(input, output, TRANSFORM_NONE, codec)) {
+		fclose(output);
+		return NULL;
+	}
+	bench_report(name, bench_now() - start, BENCH_SIZE);
+
+	return output;
+}
+
+static int bench_same(FILE *a, FILE *b)
+{
+	rewind(a);
+	rewind(b);
+
+	int c;
+	while ((c = fgetc(a)) != EOF) {
+		if (c != fgetc(b))
+			return 0;
+	}
+
+	return EOF == fgetc(b);
+}
+
+static int bench_data(unsigned char *buffer, const char *name)
+{
+	frequency_t table[HUFFMAN_MAX_SYMBOLS] = { 0 };
+	histogram_count_buffer(buffer, BENCH_SIZE, table);
+
+	FILE *input = tmpfile();
+	fwrite(buffer, 1, BENCH_SIZE, input);
+
+	codec_t codec;
+	codec_create(&codec);
+	codec_prepare(&codec, table);
+
+	int longest = 0;
+	for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++) {
+		if (0 != table[i]
+		    && encoding_length(codec.encoding_table[i]) > longest)
+			longest = encoding_length(codec.encoding_table[i]);
+	}
+	printf("Encode: %ld MB of %s (codes up to %d bits)\n",
+	       BENCH_SIZE / (1024 * 1024), name, longest);
+
+	// Reference: one lookup per symbol
+	FILE *reference = bench_encode("per symbol", input, &codec);
+
+	double start = bench_now();
+	codec_prepare_pairs(&codec);
+	bench_report("pair table build", bench_now() - start,
+		     ENCODING_PAIR_TABLE_SIZE * sizeof(pair_encoding_t));
+
+	FILE *paired = bench_encode("per pair", input, &codec);
+
+	int same = NULL != reference && NULL != paired
+	    && bench_same(reference, paired);
+	if (!same)
+		fprintf(stderr, "Output mismatch\n");
+
+	if (NULL != reference)
+		fclose(reference);
+	if (NULL != paired)
+		fclose(paired);
+	fclose(input);
+	codec_destroy(&codec);
+	printf("\n");
+
+	return same ? 0 : -1;
+}
+
+int main(void)
+{
+	unsigned char *buffer = malloc(BENCH_SIZE);
+	if (NULL == buffer)
+		return EXIT_FAILURE;
+
+	int status = 0;
+	srand(42);
+
+	// English-like letter frequencies: short codes
+	const char *letters = "eeeeeeeeeeeetttttttttaaaaaaaaoooooooiiiiiii"
+	    "nnnnnnnsssssshhhhhhrrrrrrddddllllcccuuummwwffggyyppbbvkjxqz     ";
+	size_t count = strlen(letters);
+	for (long i = 0; i < BENCH_SIZE; i++) {
+		buffer[i] = letters[rand() % count];
+	}
+	status |= bench_data(buffer, "text");
+
+	// Uniform bytes: 8-bit codes
+	for (long i = 0; i < BENCH_SIZE; i++) {
+		buffer[i] = rand();
+	}
+	status |= bench_data(buffer, "noise");
+
+	// Geometric distribution: codes too long to pair in the tail
+	for (long i = 0; i < BENCH_SIZE; i++) {
+		int symbol = 0;
+		while (symbol < 40 && (rand() & 1)) {
+			symbol++;
+		}
+		buffer[i] = symbol;
+	}
+	status |= bench_data(buffer, "geometric");
+
+	free(buffer);
+
+	return 0 == status ? EXIT_SUCCESS : EXIT_FAILURE;
+}
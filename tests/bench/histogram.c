@@ -0,0 +1,96 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "huffman/dispatch.h"
+#include "huffman/histogram.h"
+#include "huffman/statistics.h"
+
+#define BENCH_SIZE (256L * 1024 * 1024)
+
+static double bench_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void bench_report(const char *name, double elapsed, long bytes)
+{
+	printf("%-24s %8.3fs %10.1f MB/s\n", name, elapsed,
+	       bytes / elapsed / 1e6);
+}
+
+static int bench_data(unsigned char *buffer, const char *name)
+{
+	frequency_t reference[HUFFMAN_MAX_SYMBOLS] = { 0 };
+	frequency_t table[HUFFMAN_MAX_SYMBOLS];
+
+	printf("Histogram: %ld MB of %s\n", BENCH_SIZE / (1024 * 1024), name);
+
+	// Reference: one counter per symbol
+	double start = bench_now();
+	for (long i = 0; i < BENCH_SIZE; i++) {
+		reference[buffer[i]]++;
+	}
+	bench_report("reference", bench_now() - start, BENCH_SIZE);
+
+	for (int v = 0; v < CPU_VARIANT_COUNT; v++) {
+		if (!cpu_variant_supported(v))
+			continue;
+
+		memset(table, 0, sizeof(table));
+		histogram_kernel_t kernel = histogram_kernel(v);
+
+		start = bench_now();
+		for (long i = 0; i < BENCH_SIZE; i += HISTOGRAM_BUFFER_SIZE) {
+			kernel(buffer + i, HISTOGRAM_BUFFER_SIZE, table);
+		}
+		bench_report(cpu_variant_name(v), bench_now() - start,
+			     BENCH_SIZE);
+
+		if (0 != memcmp(reference, table, sizeof(table))) {
+			fprintf(stderr, "Mismatch for %s\n",
+				cpu_variant_name(v));
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	unsigned char *buffer = malloc(BENCH_SIZE);
+	if (NULL == buffer)
+		return EXIT_FAILURE;
+
+	srand(42);
+	for (long i = 0; i < BENCH_SIZE; i++) {
+		buffer[i] = rand();
+	}
+	if (0 != bench_data(buffer, "random bytes"))
+		return EXIT_FAILURE;
+
+	// Text-like: a few dozen symbols, no runs
+	for (long i = 0; i < BENCH_SIZE; i++) {
+		buffer[i] = ' ' + rand() % (1 + rand() % 64);
+	}
+	if (0 != bench_data(buffer, "text"))
+		return EXIT_FAILURE;
+
+	// Long runs of a single byte
+	for (long i = 0; i < BENCH_SIZE; i++) {
+		buffer[i] = (i >> 16) & 0x3;
+	}
+	if (0 != bench_data(buffer, "runs"))
+		return EXIT_FAILURE;
+
+	free(buffer);
+
+	return EXIT_SUCCESS;
+}
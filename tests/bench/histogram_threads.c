@@ -0,0 +1,112 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "huffman/histogram.h"
+#include "huffman/statistics.h"
+
+// Generated input, unless HUFFMAN_BENCH_INPUT names a file
+#define BENCH_SIZE (2L * 1024 * 1024 * 1024)
+#define BENCH_ENVIRONMENT "HUFFMAN_BENCH_INPUT"
+
+static double bench_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void bench_report(const char *name, double elapsed, long bytes)
+{
+	printf("%-24s %8.3fs %10.1f MB/s\n", name, elapsed,
+	       bytes / elapsed / 1e6);
+}
+
+static int bench_generate(char *path)
+{
+	int fd = mkstemp(path);
+	if (fd < 0)
+		return -1;
+
+	size_t size = 1024 * 1024;
+	unsigned char *buffer = malloc(size);
+	if (NULL == buffer) {
+		close(fd);
+		return -1;
+	}
+
+	srand(42);
+	for (long written = 0; written < BENCH_SIZE; written += size) {
+		for (size_t i = 0; i < size; i++) {
+			buffer[i] = 'a' + rand() % (1 + rand() % 26);
+		}
+		if (write(fd, buffer, size) != (ssize_t)size) {
+			free(buffer);
+			close(fd);
+			return -1;
+		}
+	}
+
+	free(buffer);
+	return fd;
+}
+
+int main(void)
+{
+	char path[] = "/tmp/huffman_bench_XXXXXX";
+	const char *input = getenv(BENCH_ENVIRONMENT);
+	int fd = NULL != input ? open(input, O_RDONLY) : bench_generate(path);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open the input\n");
+		return EXIT_FAILURE;
+	}
+	if (NULL == input)
+		unlink(path);
+
+	struct stat info;
+	fstat(fd, &info);
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int max_threads = cpus > 8 ? cpus : 8;
+
+	printf("Histogram threads: %ld MB, %ld online CPUs\n",
+	       (long)info.st_size / (1024 * 1024), cpus);
+
+	// Warm the page cache so that the first run is not penalized
+	frequency_t reference[HUFFMAN_MAX_SYMBOLS] = { 0 };
+	histogram_count_parallel(fd, 0, info.st_size, 1, reference);
+
+	int status = EXIT_SUCCESS;
+	for (int threads = 1; threads <= max_threads;) {
+		frequency_t table[HUFFMAN_MAX_SYMBOLS] = { 0 };
+
+		double start = bench_now();
+		histogram_count_parallel(fd, 0, info.st_size, threads, table);
+		char name[32];
+		snprintf(name, sizeof(name), "%d thread%s", threads,
+			 1 == threads ? "" : "s");
+		bench_report(name, bench_now() - start, info.st_size);
+
+		if (0 != memcmp(table, reference, sizeof(table))) {
+			fprintf(stderr, "Counts differ with %d threads\n",
+				threads);
+			status = EXIT_FAILURE;
+		}
+
+		// Powers of two, with a stop at the CPU count in between
+		int next = 1;
+		while (next <= threads) {
+			next *= 2;
+		}
+		threads = threads < cpus && cpus < next ? cpus : next;
+	}
+
+	close(fd);
+	return status;
+}
@@ -0,0 +1,108 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "huffman/output.h"
+
+#define BENCH_SIZE (1024L * 1024 * 1024)
+// Written next to the build: tmpfs (often /tmp) has no direct I/O
+#define BENCH_PATH "tests/bin/bench_output.dat"
+
+static double bench_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Share of the file's pages resident in the page cache
+static double bench_resident(const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	struct stat info;
+	fstat(fd, &info);
+	long page = sysconf(_SC_PAGESIZE);
+	size_t pages = (info.st_size + page - 1) / page;
+	unsigned char *vector = malloc(pages);
+	void *map = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+	size_t resident = 0;
+	if (NULL != vector && MAP_FAILED != map
+	    && 0 == mincore(map, info.st_size, vector)) {
+		for (size_t i = 0; i < pages; i++) {
+			resident += vector[i] & 1;
+		}
+	}
+
+	if (MAP_FAILED != map)
+		munmap(map, info.st_size);
+	free(vector);
+	close(fd);
+
+	return pages > 0 ? (double)resident / pages : 0;
+}
+
+static int bench_write(const char *name, int mode, long size)
+{
+	unlink(BENCH_PATH);
+
+	output_t output;
+	double start = bench_now();
+	int status = 0 == mode ? output_open(&output, BENCH_PATH, 0) :
+	    1 == mode ? output_open(&output, BENCH_PATH, size) :
+	    output_open_direct(&output, BENCH_PATH, size);
+	if (0 != status)
+		return -1;
+
+	// Odd size: the direct tail is not aligned
+	for (long i = 0; i < size; i++) {
+		output_put(&output, (unsigned char)(i * 7));
+	}
+	int direct = output_is_direct(&output);
+	status = output_close(&output);
+	double elapsed = bench_now() - start;
+
+	printf("%-24s %8.3fs %10.1f MB/s %7.1f%% cached%s\n", name, elapsed,
+	       size / elapsed / 1e6, 100 * bench_resident(BENCH_PATH),
+	       2 == mode && !direct ? " (no O_DIRECT)" : "");
+
+	return status;
+}
+
+int main(void)
+{
+	long size = BENCH_SIZE + 123;
+	printf("Output: %ld MB\n", size / (1024 * 1024));
+
+	int status = 0;
+	status |= bench_write("buffered", 0, size);
+	status |= bench_write("mapped", 1, size);
+	status |= bench_write("direct", 2, size);
+
+	// The direct file holds what was written
+	FILE *file = fopen(BENCH_PATH, "r");
+	if (NULL != file) {
+		fseek(file, 0, SEEK_END);
+		status |= ftell(file) != size;
+		fseek(file, size - 1, SEEK_SET);
+		status |= fgetc(file) != (unsigned char)((size - 1) * 7);
+		fclose(file);
+	}
+	unlink(BENCH_PATH);
+
+	if (0 != status)
+		fprintf(stderr, "Output mismatch\n");
+
+	return 0 == status ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,12 @@
+#ifndef ANALYSIS_TEST_H
+#define ANALYSIS_TEST_H
+
+#include "huffman/analysis.h"
+
+void test_analyze_exact(void);
+void test_analyze_entropy(void);
+void test_analyze_empty(void);
+void test_analyze_blocks(void);
+void test_analyze_output(void);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef ARCHIVE_TEST_H
+#define ARCHIVE_TEST_H
+
+#include "huffman/archive.h"
+
+void test_archive_roundtrip(void);
+void test_archive_extract_one(void);
+void test_archive_errors(void);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef BITSTREAM_TEST_H
+#define BITSTREAM_TEST_H
+
+#include "huffman/bitstream.h"
+
+void test_bit_writer_padding(void);
+void test_bit_writer_large(void);
+void test_bit_writer_failed(void);
+void test_bit_reader_peek_consume(void);
+void test_bit_reader_past_end(void);
+void test_bitstream_roundtrip(void);
+void test_encoding_pack(void);
+void test_encoding_pair(void);
+
+#endif
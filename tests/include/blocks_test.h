@@ -0,0 +1,11 @@
+#ifndef BLOCKS_TEST_H
+#define BLOCKS_TEST_H
+
+#include "huffman/blocks.h"
+
+void test_blocks_split(void);
+void test_blocks_budget(void);
+void test_blocks_roundtrip(void);
+void test_blocks_automatic(void);
+
+#endif
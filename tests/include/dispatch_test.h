@@ -0,0 +1,10 @@
+#ifndef DISPATCH_TEST_H
+#define DISPATCH_TEST_H
+
+#include "huffman/dispatch.h"
+
+void test_cpu_variant_parse(void);
+void test_dispatch_select(void);
+void test_histogram_kernels_identical(void);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef HISTOGRAM_TEST_H
+#define HISTOGRAM_TEST_H
+
+#include "huffman/histogram.h"
+
+void test_compression_level_parse(void);
+
+void test_histogram_count_buffer(void);
+void test_histogram_count(void);
+void test_histogram_count_parallel(void);
+void test_histogram_count_chunks(void);
+void test_histogram_count_unaligned(void);
+void test_histogram_sample_small(void);
+void test_histogram_sample_escape(void);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef MEMORY_TEST_H
+#define MEMORY_TEST_H
+
+#include "huffman/memory.h"
+
+void test_memory_parse_size(void);
+void test_memory_configure(void);
+void test_memory_degrade(void);
+void test_memory_phases(void);
+
+#endif
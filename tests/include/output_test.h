@@ -0,0 +1,13 @@
+#ifndef OUTPUT_TEST_H
+#define OUTPUT_TEST_H
+
+#include "huffman/output.h"
+
+void test_output_mapped(void);
+void test_output_region(void);
+void test_output_overflow(void);
+void test_output_short(void);
+void test_output_buffered(void);
+void test_output_direct(void);
+
+#endif
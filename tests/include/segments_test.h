@@ -0,0 +1,14 @@
+#ifndef SEGMENTS_TEST_H
+#define SEGMENTS_TEST_H
+
+#include "huffman/segments.h"
+
+void test_segments_append(void);
+void test_segments_from_stream(void);
+void test_segments_interrupted(void);
+void test_segments_interrupted_stream(void);
+void test_segments_growth(void);
+void test_segments_sampled(void);
+void test_segments_errors(void);
+
+#endif
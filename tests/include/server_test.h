@@ -0,0 +1,14 @@
+#ifndef SERVER_TEST_H
+#define SERVER_TEST_H
+
+#include "huffman/server.h"
+
+void test_server_roundtrip(void);
+void test_server_errors(void);
+void test_server_stats(void);
+void test_server_memory_limit(void);
+void test_server_max_payload(void);
+void test_server_connections(void);
+void test_server_path(void);
+
+#endif
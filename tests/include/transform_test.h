@@ -0,0 +1,12 @@
+#ifndef TRANSFORM_TEST_H
+#define TRANSFORM_TEST_H
+
+#include "huffman/transform.h"
+
+void test_transform_parse(void);
+void test_transform_rle(void);
+void test_transform_roundtrip(void);
+void test_transform_select(void);
+void test_transform_compress_stream(void);
+
+#endif
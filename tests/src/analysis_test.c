@@ -0,0 +1,180 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "huffman/analysis.h"
+#include "huffman/blocks.h"
+#include "huffman/codec.h"
+#include "huffman/transform.h"
+#include "analysis_test.h"
+
+void test_analyze_exact(void)
+{
+	FILE *input = tmpfile();
+	unsigned int state = 7;
+	for (int i = 0; i < 300000; i++) {
+		state = state * 1103515245 + 12345;
+		// Skewed towards small values
+		fputc((state >> 16) % ((state >> 8) % 64 + 1), input);
+	}
+
+	codec_t codec;
+	codec_create(&codec);
+	analysis_t analysis;
+	CU_ASSERT_EQUAL_FATAL(analyze_stream(input, COMPRESSION_LEVEL_NORMAL,
+					     TRANSFORM_NONE, &codec,
+					     &analysis), 0);
+	CU_ASSERT_EQUAL(ftell(input), 0);
+
+	// The analysis predicts the output of compress to the byte
+	FILE *output = tmpfile();
+	CU_ASSERT_EQUAL(compress_stream(input, output,
+					COMPRESSION_LEVEL_NORMAL,
+					TRANSFORM_NONE, &codec), 0);
+	CU_ASSERT_EQUAL(analysis.compressed_size, ftell(output));
+	CU_ASSERT_EQUAL(analysis.file_length, 300000);
+	CU_ASSERT_FALSE(analysis.sampled);
+	CU_ASSERT_EQUAL(analysis.symbol_count, 64);
+	CU_ASSERT(analysis.entropy > 0 && analysis.entropy < 6);
+	CU_ASSERT(analysis.max_code_length >= 6);
+	CU_ASSERT(analysis.estimated_time > 0);
+
+	codec_destroy(&codec);
+	fclose(input);
+	fclose(output);
+}
+
+void test_analyze_entropy(void)
+{
+	FILE *input = tmpfile();
+	for (int i = 0; i < 1000; i++) {
+		fputc(i % 2 ? 'a' : 'b', input);
+	}
+
+	codec_t codec;
+	codec_create(&codec);
+	analysis_t analysis;
+	CU_ASSERT_EQUAL_FATAL(analyze_stream(input, COMPRESSION_LEVEL_FAST,
+					     TRANSFORM_NONE, &codec,
+					     &analysis), 0);
+
+	CU_ASSERT_FALSE(analysis.sampled);
+	CU_ASSERT_DOUBLE_EQUAL(analysis.entropy, 1.0, 1e-9);
+	CU_ASSERT_EQUAL(analysis.max_code_length, 1);
+	CU_ASSERT_EQUAL(analysis.coded_size, 125);
+	CU_ASSERT_EQUAL(analysis.header_size,
+			HUFFMAN_MAGIC_SIZE + HUFFMAN_FILE_LENGTH_SIZE +
+			HUFFMAN_SYMBOL_COUNT_SIZE +
+			2 * (HUFFMAN_SYMBOL_SIZE + HUFFMAN_FREQUENCY_SIZE));
+
+	codec_destroy(&codec);
+	fclose(input);
+}
+
+void test_analyze_empty(void)
+{
+	FILE *input = tmpfile();
+
+	codec_t codec;
+	codec_create(&codec);
+	analysis_t analysis;
+	CU_ASSERT_EQUAL(analyze_stream(input, COMPRESSION_LEVEL_NORMAL,
+				       TRANSFORM_NONE, &codec, &analysis), 0);
+	CU_ASSERT_EQUAL(analysis.file_length, 0);
+	CU_ASSERT_EQUAL(analysis.symbol_count, 0);
+	CU_ASSERT_EQUAL(analysis.compressed_size,
+			HUFFMAN_MAGIC_SIZE + HUFFMAN_FILE_LENGTH_SIZE);
+
+	codec_destroy(&codec);
+	fclose(input);
+}
+
+void test_analyze_blocks(void)
+{
+	// Two halves over distinct alphabets
+	long length = 2 * BLOCKS_MIN_LENGTH;
+	FILE *input = tmpfile();
+	unsigned int state = 5;
+	for (long i = 0; i < length; i++) {
+		state = state * 1103515245 + 12345;
+		fputc((i < length / 2 ? 'a' : 'A') + (state >> 16) % 8, input);
+	}
+
+	codec_t codec;
+	codec_create(&codec);
+	analysis_t analysis;
+	CU_ASSERT_EQUAL_FATAL(analyze_stream(input, COMPRESSION_LEVEL_NORMAL,
+					     TRANSFORM_NONE, &codec,
+					     &analysis), 0);
+	CU_ASSERT_EQUAL(analysis.block_count, 2);
+	CU_ASSERT(analysis.blocks_size < analysis.header_size +
+		  analysis.coded_size);
+
+	// Compress splits the input the same way
+	FILE *output = tmpfile();
+	CU_ASSERT_EQUAL(compress_stream(input, output,
+					COMPRESSION_LEVEL_NORMAL,
+					TRANSFORM_NONE, &codec), 0);
+	CU_ASSERT_EQUAL(analysis.compressed_size, analysis.blocks_size);
+	CU_ASSERT_EQUAL(analysis.compressed_size, ftell(output));
+
+	codec_destroy(&codec);
+	fclose(input);
+	fclose(output);
+}
+
+void test_analyze_output(void)
+{
+	// A ramp, which the filters shrink, text, and two halves over
+	// distinct alphabets, which are split into blocks
+	long lengths[] = { 0, 300000, 300000, 2 * BLOCKS_MIN_LENGTH };
+	compression_level_t levels[] = {
+		COMPRESSION_LEVEL_NORMAL, COMPRESSION_LEVEL_FAST
+	};
+
+	codec_t codec;
+	codec_create(&codec);
+	for (int data = 0; data < 4; data++) {
+		FILE *input = tmpfile();
+		unsigned int state = 3;
+		for (long i = 0; i < lengths[data]; i++) {
+			state = state * 1103515245 + 12345;
+			int byte = 1 == data ? i % 251 :
+			    2 == data ? "the quick brown fox "[i % 20] :
+			    (i < lengths[data] / 2 ? 'a' : 'A') +
+			    (state >> 16) % 8;
+			fputc(byte, input);
+		}
+
+		for (int i = 0; i < 2; i++) {
+			compression_level_t level = levels[i];
+			analysis_t analysis;
+			CU_ASSERT_EQUAL_FATAL(analyze_stream(input, level,
+							     TRANSFORM_AUTO,
+							     &codec,
+							     &analysis), 0);
+
+			// The analysis predicts the output of compress to the
+			// byte, with the same filters and blocks
+			FILE *output = tmpfile();
+			CU_ASSERT_EQUAL(compress_stream(input, output, level,
+							TRANSFORM_AUTO,
+							&codec), 0);
+			CU_ASSERT_EQUAL(analysis.compressed_size,
+					ftell(output));
+			fclose(output);
+
+			if (COMPRESSION_LEVEL_FAST == level)
+				continue;
+			if (1 == data)
+				CU_ASSERT_NOT_EQUAL(analysis.filters,
+						    TRANSFORM_NONE);
+			if (3 == data)
+				CU_ASSERT_EQUAL(analysis.block_count, 2);
+		}
+
+		fclose(input);
+	}
+	codec_destroy(&codec);
+}
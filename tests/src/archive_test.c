@@ -0,0 +1,219 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "huffman/archive.h"
+#include "archive_test.h"
+
+#define ARCHIVE_TEST_MEMBERS 5
+
+static char archive_test_directory[64];
+static char archive_test_paths[ARCHIVE_TEST_MEMBERS][128];
+
+static const char *archive_test_contents[ARCHIVE_TEST_MEMBERS] = {
+	"", "a", "abracadabra", "the quick brown fox jumps over the lazy dog",
+	"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab"
+};
+
+static int archive_test_setup(void)
+{
+	snprintf(archive_test_directory, sizeof(archive_test_directory),
+		 "/tmp/huffman_archive_test_XXXXXX");
+	if (NULL == mkdtemp(archive_test_directory))
+		return -1;
+
+	for (int i = 0; i < ARCHIVE_TEST_MEMBERS; i++) {
+		snprintf(archive_test_paths[i], sizeof(archive_test_paths[i]),
+			 "%s/member_%d", archive_test_directory, i);
+		FILE *file = fopen(archive_test_paths[i], "w");
+		if (NULL == file)
+			return -1;
+		fputs(archive_test_contents[i], file);
+		fclose(file);
+	}
+
+	return 0;
+}
+
+static void archive_test_teardown(void)
+{
+	char command[256];
+	snprintf(command, sizeof(command), "rm -rf %s",
+		 archive_test_directory);
+	CU_ASSERT_EQUAL(system(command), 0);
+}
+
+// Extracted members keep their (relative) names below `directory`
+static int archive_test_check(const char *directory, int index)
+{
+	char path[512];
+	snprintf(path, sizeof(path), "%s/%s", directory,
+		 archive_test_paths[index] + 1);
+
+	FILE *file = fopen(path, "r");
+	if (NULL == file)
+		return -1;
+
+	char content[256] = { 0 };
+	size_t length = fread(content, 1, sizeof(content) - 1, file);
+	fclose(file);
+
+	return length == strlen(archive_test_contents[index])
+	    && 0 == strcmp(content, archive_test_contents[index]) ? 0 : -1;
+}
+
+void test_archive_roundtrip(void)
+{
+	CU_ASSERT_EQUAL_FATAL(archive_test_setup(), 0);
+
+	char *paths[ARCHIVE_TEST_MEMBERS];
+	for (int i = 0; i < ARCHIVE_TEST_MEMBERS; i++) {
+		paths[i] = archive_test_paths[i];
+	}
+
+	archive_table_t tables[] =
+	    { ARCHIVE_TABLE_AUTO, ARCHIVE_TABLE_OWN, ARCHIVE_TABLE_SHARED };
+	for (size_t t = 0; t < sizeof(tables) / sizeof(tables[0]); t++) {
+		char filename[128], directory[128];
+		snprintf(filename, sizeof(filename), "%s/archive_%zu.hufa",
+			 archive_test_directory, t);
+		snprintf(directory, sizeof(directory), "%s/out_%zu",
+			 archive_test_directory, t);
+
+		CU_ASSERT_EQUAL_FATAL(archive_create
+				      (filename, paths, ARCHIVE_TEST_MEMBERS,
+				       tables[t]), 0);
+
+		archive_t archive;
+		CU_ASSERT_EQUAL_FATAL(archive_open(&archive, filename), 0);
+		CU_ASSERT_EQUAL(archive.count, ARCHIVE_TEST_MEMBERS);
+
+		unsigned int indices[ARCHIVE_TEST_MEMBERS];
+		for (int i = 0; i < ARCHIVE_TEST_MEMBERS; i++) {
+			CU_ASSERT_STRING_EQUAL(archive.members[i].name,
+					       archive_test_paths[i] + 1);
+			CU_ASSERT_EQUAL(archive.members[i].length,
+					strlen(archive_test_contents[i]));
+			if (ARCHIVE_TABLE_AUTO != tables[t])
+				CU_ASSERT_EQUAL(archive.members[i].flags &
+						ARCHIVE_MEMBER_SHARED,
+						ARCHIVE_TABLE_SHARED ==
+						tables[t] ?
+						ARCHIVE_MEMBER_SHARED : 0);
+			indices[i] = i;
+		}
+
+		CU_ASSERT_EQUAL(archive_extract(&archive, indices,
+						ARCHIVE_TEST_MEMBERS,
+						directory, 3), 0);
+		for (int i = 0; i < ARCHIVE_TEST_MEMBERS; i++) {
+			CU_ASSERT_EQUAL(archive_test_check(directory, i), 0);
+		}
+
+		archive_close(&archive);
+	}
+
+	archive_test_teardown();
+}
+
+void test_archive_extract_one(void)
+{
+	CU_ASSERT_EQUAL_FATAL(archive_test_setup(), 0);
+
+	char *paths[ARCHIVE_TEST_MEMBERS];
+	for (int i = 0; i < ARCHIVE_TEST_MEMBERS; i++) {
+		paths[i] = archive_test_paths[i];
+	}
+
+	char filename[128], directory[128];
+	snprintf(filename, sizeof(filename), "%s/archive.hufa",
+		 archive_test_directory);
+	snprintf(directory, sizeof(directory), "%s/out",
+		 archive_test_directory);
+	CU_ASSERT_EQUAL_FATAL(archive_create(filename, paths,
+					     ARCHIVE_TEST_MEMBERS,
+					     ARCHIVE_TABLE_AUTO), 0);
+
+	archive_t archive;
+	CU_ASSERT_EQUAL_FATAL(archive_open(&archive, filename), 0);
+
+	int index = archive_find(&archive, archive_test_paths[3]);
+	CU_ASSERT_EQUAL(index, 3);
+	CU_ASSERT_EQUAL(archive_find(&archive, "missing"), -1);
+
+	unsigned int indices[] = { index };
+	CU_ASSERT_EQUAL(archive_extract(&archive, indices, 1, directory, 4), 0);
+	CU_ASSERT_EQUAL(archive_test_check(directory, 3), 0);
+	CU_ASSERT_EQUAL(archive_test_check(directory, 2), -1);
+
+	archive_close(&archive);
+	archive_test_teardown();
+}
+
+void test_archive_errors(void)
+{
+	CU_ASSERT_EQUAL_FATAL(archive_test_setup(), 0);
+
+	archive_t archive;
+	CU_ASSERT_EQUAL(archive_open(&archive, archive_test_paths[3]), -1);
+	CU_ASSERT_EQUAL(archive_open(&archive, "/nonexistent.hufa"), -1);
+
+	char *missing[] = { "/nonexistent" };
+	char filename[128];
+	snprintf(filename, sizeof(filename), "%s/archive.hufa",
+		 archive_test_directory);
+	CU_ASSERT_EQUAL(archive_create(filename, missing, 1,
+				       ARCHIVE_TABLE_AUTO), -1);
+
+	// Names escaping the destination are refused
+	char *paths[] = { archive_test_paths[2] };
+	CU_ASSERT_EQUAL_FATAL(archive_create(filename, paths, 1,
+					     ARCHIVE_TABLE_OWN), 0);
+	CU_ASSERT_EQUAL_FATAL(archive_open(&archive, filename), 0);
+	free(archive.members[0].name);
+	archive.members[0].name = strdup("../escape");
+
+	FILE *file = fopen(filename, "r");
+	codec_t codec;
+	codec_create(&codec);
+	CU_ASSERT_EQUAL(archive_extract_member(&archive, file, 0,
+					       archive_test_directory,
+					       &codec), -1);
+	codec_destroy(&codec);
+	fclose(file);
+
+	unsigned int indices[] = { 1 };
+	CU_ASSERT_EQUAL(archive_extract(&archive, indices, 1,
+					archive_test_directory, 1), -1);
+	archive_close(&archive);
+
+	// Or when the archive is created
+	CU_ASSERT_FALSE(__archive_name_safe("a/../../b"));
+	CU_ASSERT_FALSE(__archive_name_safe("a/.."));
+	CU_ASSERT_FALSE(__archive_name_safe(""));
+	CU_ASSERT_TRUE(__archive_name_safe("a/..b"));
+	char escape[256];
+	snprintf(escape, sizeof(escape), "../%s", archive_test_paths[2]);
+	char *escaping[] = { escape };
+	CU_ASSERT_EQUAL(archive_create(filename, escaping, 1,
+				       ARCHIVE_TABLE_OWN), -1);
+
+	// Duplicate names are refused, and not extracted twice at once
+	char *duplicates[] = { archive_test_paths[2], archive_test_paths[2] };
+	CU_ASSERT_EQUAL(archive_create(filename, duplicates, 2,
+				       ARCHIVE_TABLE_OWN), -1);
+	CU_ASSERT_EQUAL_FATAL(archive_create(filename, paths, 1,
+					     ARCHIVE_TABLE_OWN), 0);
+	CU_ASSERT_EQUAL_FATAL(archive_open(&archive, filename), 0);
+	unsigned int twice[] = { 0, 0 };
+	CU_ASSERT_EQUAL(archive_extract(&archive, twice, 2,
+					archive_test_directory, 2), -1);
+	archive_close(&archive);
+
+	archive_test_teardown();
+}
@@ -0,0 +1,204 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "huffman/bitstream.h"
+#include "huffman/encoding_table.h"
+#include "bitstream_test.h"
+
+void test_bit_writer_padding(void)
+{
+	FILE *file = tmpfile();
+	bit_writer_t writer;
+	CU_ASSERT_EQUAL(bit_writer_create(&writer, file), 0);
+
+	bit_writer_put(&writer, 0x1, 1);
+	bit_writer_put(&writer, 0x2, 3);
+	bit_writer_put(&writer, 0x7, 3);
+	bit_writer_put(&writer, 0x3, 2);
+	CU_ASSERT_EQUAL(bit_writer_flush(&writer), 0);
+	bit_writer_destroy(&writer);
+
+	// 1 010 111 1|1 0000000
+	CU_ASSERT_EQUAL(ftell(file), 2);
+	rewind(file);
+	CU_ASSERT_EQUAL(fgetc(file), 0xAF);
+	CU_ASSERT_EQUAL(fgetc(file), 0x80);
+	CU_ASSERT_EQUAL(fgetc(file), EOF);
+
+	fclose(file);
+}
+
+void test_bit_writer_large(void)
+{
+	FILE *file = tmpfile();
+	bit_writer_t writer;
+	CU_ASSERT_EQUAL(bit_writer_create(&writer, file), 0);
+
+	// Several times the buffer size, with codes straddling words
+	long count = 3L * BITSTREAM_BUFFER_SIZE;
+	for (long i = 0; i < count; i++) {
+		bit_writer_put(&writer, 0x5A, 8);
+	}
+	CU_ASSERT_EQUAL(bit_writer_flush(&writer), 0);
+	bit_writer_destroy(&writer);
+
+	CU_ASSERT_EQUAL(ftell(file), count);
+	rewind(file);
+	int c, mismatches = 0;
+	while ((c = fgetc(file)) != EOF) {
+		mismatches += c != 0x5A;
+	}
+	CU_ASSERT_EQUAL(mismatches, 0);
+
+	fclose(file);
+}
+
+void test_bit_writer_failed(void)
+{
+	// Unbuffered, so that the first write reports the full device
+	FILE *file = fopen("/dev/full", "w");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(file);
+	setvbuf(file, NULL, _IONBF, 0);
+
+	bit_writer_t writer;
+	CU_ASSERT_EQUAL(bit_writer_create(&writer, file), 0);
+
+	long count = 2L * BITSTREAM_BUFFER_SIZE;
+	for (long i = 0; i < count; i++) {
+		bit_writer_put(&writer, 0x5A, 8);
+	}
+	CU_ASSERT_TRUE(writer.failed);
+	CU_ASSERT_EQUAL(bit_writer_flush(&writer), -1);
+	bit_writer_destroy(&writer);
+
+	fclose(file);
+}
+
+void test_bit_reader_peek_consume(void)
+{
+	FILE *file = tmpfile();
+	fputc(0xAF, file);
+	fputc(0x80, file);
+	rewind(file);
+
+	bit_reader_t reader;
+	CU_ASSERT_EQUAL(bit_reader_create(&reader, file), 0);
+
+	CU_ASSERT_EQUAL(bit_reader_peek(&reader, 4), 0xA);
+	CU_ASSERT_EQUAL(bit_reader_peek(&reader, 1), 0x1);
+	bit_reader_consume(&reader, 1);
+	CU_ASSERT_EQUAL(bit_reader_read(&reader, 3), 0x2);
+	CU_ASSERT_EQUAL(bit_reader_read(&reader, 3), 0x7);
+	CU_ASSERT_EQUAL(bit_reader_read(&reader, 2), 0x3);
+
+	bit_reader_destroy(&reader);
+	fclose(file);
+}
+
+void test_bit_reader_past_end(void)
+{
+	FILE *file = tmpfile();
+	fputc(0xFF, file);
+	rewind(file);
+
+	bit_reader_t reader;
+	CU_ASSERT_EQUAL(bit_reader_create(&reader, file), 0);
+
+	CU_ASSERT_EQUAL(bit_reader_read(&reader, 4), 0xF);
+	CU_ASSERT_EQUAL(bit_reader_read(&reader, 8), 0xF0);
+	for (int i = 0; i < 4; i++) {
+		CU_ASSERT_EQUAL(bit_reader_read(&reader, BITSTREAM_MAX_BITS),
+				0);
+	}
+
+	bit_reader_destroy(&reader);
+	fclose(file);
+}
+
+void test_bitstream_roundtrip(void)
+{
+	FILE *file = tmpfile();
+	bit_writer_t writer;
+	CU_ASSERT_EQUAL(bit_writer_create(&writer, file), 0);
+
+	long count = BITSTREAM_BUFFER_SIZE;
+	srand(42);
+	for (long i = 0; i < count; i++) {
+		unsigned int length = 1 + i % BITSTREAM_MAX_BITS;
+		uint64_t bits = (((uint64_t) rand() << 32) ^ rand())
+		    & ((UINT64_C(1) << length) - 1);
+		bit_writer_put(&writer, bits, length);
+	}
+	CU_ASSERT_EQUAL(bit_writer_flush(&writer), 0);
+	bit_writer_destroy(&writer);
+	rewind(file);
+
+	bit_reader_t reader;
+	CU_ASSERT_EQUAL(bit_reader_create(&reader, file), 0);
+
+	int mismatches = 0;
+	srand(42);
+	for (long i = 0; i < count; i++) {
+		unsigned int length = 1 + i % BITSTREAM_MAX_BITS;
+		uint64_t bits = (((uint64_t) rand() << 32) ^ rand())
+		    & ((UINT64_C(1) << length) - 1);
+		mismatches += bit_reader_read(&reader, length) != bits;
+	}
+	CU_ASSERT_EQUAL(mismatches, 0);
+
+	bit_reader_destroy(&reader);
+	fclose(file);
+}
+
+void test_encoding_pack(void)
+{
+	encoding_t encoding = encoding_create();
+	encoding_set(&encoding, 0, 1);
+	encoding_set(&encoding, 1, 0);
+	encoding_set(&encoding, 2, 1);
+	encoding_set(&encoding, 3, 1);
+
+	packed_encoding_t packed = encoding_pack(encoding, BITSTREAM_MAX_BITS);
+	CU_ASSERT_EQUAL(packed.bits, 0xB);
+	CU_ASSERT_EQUAL(packed.length, 4);
+
+	packed = encoding_pack(encoding, 3);
+	CU_ASSERT_EQUAL(packed.length, 0);
+
+	encoding_destroy(&encoding);
+
+	packed = encoding_pack(encoding, BITSTREAM_MAX_BITS);
+	CU_ASSERT_EQUAL(packed.length, 0);
+}
+
+void test_encoding_pair(void)
+{
+	packed_encoding_t packed[HUFFMAN_MAX_SYMBOLS] = { {0, 0} };
+	packed['a'] = (packed_encoding_t) {.bits = 0x1,.length = 1 };
+	packed['b'] = (packed_encoding_t) {.bits = 0x5,.length = 3 };
+	packed['c'] = (packed_encoding_t) {.bits = 0x3FF,.length = 30 };
+
+	pair_encoding_t *pairs =
+	    malloc(ENCODING_PAIR_TABLE_SIZE * sizeof(pair_encoding_t));
+	encoding_table_pair(packed, pairs, BITSTREAM_MAX_BITS);
+
+	// 1 101
+	pair_encoding_t pair = pairs[('a' << 8) | 'b'];
+	CU_ASSERT_EQUAL(PAIR_ENCODING_BITS(pair), 0xD);
+	CU_ASSERT_EQUAL(PAIR_ENCODING_LENGTH(pair), 4);
+	pair = pairs[('b' << 8) | 'a'];
+	CU_ASSERT_EQUAL(PAIR_ENCODING_BITS(pair), 0xB);
+	CU_ASSERT_EQUAL(PAIR_ENCODING_LENGTH(pair), 4);
+	pair = pairs[('c' << 8) | 'a'];
+	CU_ASSERT_EQUAL(PAIR_ENCODING_BITS(pair), 0x7FF);
+	CU_ASSERT_EQUAL(PAIR_ENCODING_LENGTH(pair), 31);
+
+	// Too long together, or not packed
+	CU_ASSERT_EQUAL(pairs[('c' << 8) | 'c'], 0);
+	CU_ASSERT_EQUAL(pairs[('a' << 8) | 'd'], 0);
+
+	free(pairs);
+}
@@ -0,0 +1,192 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "huffman/blocks.h"
+#include "huffman/codec.h"
+#include "huffman/huffman.h"
+#include "huffman/statistics.h"
+#include "huffman/transform.h"
+#include "blocks_test.h"
+
+#define BLOCKS_TEST_CHUNKS 8
+
+// Chunks of text over a few letters, then of bytes spread evenly
+static void blocks_test_chunks(frequency_t *chunks, unsigned int split)
+{
+	memset(chunks, 0,
+	       BLOCKS_TEST_CHUNKS * HUFFMAN_MAX_SYMBOLS * sizeof(frequency_t));
+	for (unsigned int k = 0; k < BLOCKS_TEST_CHUNKS; k++) {
+		frequency_t *table = chunks + k * HUFFMAN_MAX_SYMBOLS;
+		for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++) {
+			if (k >= split)
+				table[i] =
+				    BLOCKS_CHUNK_SIZE / HUFFMAN_MAX_SYMBOLS;
+			else if (i >= 'a' && i < 'e')
+				table[i] = BLOCKS_CHUNK_SIZE / 4;
+		}
+	}
+}
+
+void test_blocks_split(void)
+{
+	frequency_t chunks[BLOCKS_TEST_CHUNKS * HUFFMAN_MAX_SYMBOLS];
+	long unsigned int length = BLOCKS_TEST_CHUNKS * BLOCKS_CHUNK_SIZE;
+	blocks_t blocks;
+
+	// A change of distribution starts a block
+	blocks_test_chunks(chunks, 3);
+	CU_ASSERT_EQUAL_FATAL(blocks_split(chunks, BLOCKS_TEST_CHUNKS,
+					   BLOCKS_CHUNK_SIZE, length, 4,
+					   &blocks), 0);
+	CU_ASSERT_EQUAL_FATAL(blocks.count, 2);
+	CU_ASSERT_EQUAL(blocks.blocks[0].length, 3 * BLOCKS_CHUNK_SIZE);
+	CU_ASSERT_EQUAL(blocks.blocks[1].length, 5 * BLOCKS_CHUNK_SIZE);
+	CU_ASSERT_EQUAL(blocks.blocks[0].table['a'], 3 * BLOCKS_CHUNK_SIZE / 4);
+	CU_ASSERT_EQUAL(blocks.blocks[0].table['z'], 0);
+	blocks_destroy(&blocks);
+
+	// Uniform statistics stay in one block
+	blocks_test_chunks(chunks, BLOCKS_TEST_CHUNKS);
+	CU_ASSERT_EQUAL_FATAL(blocks_split(chunks, BLOCKS_TEST_CHUNKS,
+					   BLOCKS_CHUNK_SIZE, length, 4,
+					   &blocks), 0);
+	CU_ASSERT_EQUAL(blocks.count, 1);
+	CU_ASSERT_EQUAL(blocks.blocks[0].length, length);
+	blocks_destroy(&blocks);
+
+	// The last chunk may be short
+	blocks_test_chunks(chunks, 3);
+	CU_ASSERT_EQUAL_FATAL(blocks_split(chunks, BLOCKS_TEST_CHUNKS,
+					   BLOCKS_CHUNK_SIZE, length - 10, 4,
+					   &blocks), 0);
+	CU_ASSERT_EQUAL(blocks.blocks[blocks.count - 1].length,
+			5 * BLOCKS_CHUNK_SIZE - 10);
+	blocks_destroy(&blocks);
+}
+
+void test_blocks_budget(void)
+{
+	// Small inputs may be split in two, larger ones once per minimum
+	// length
+	CU_ASSERT_EQUAL(blocks_budget(0), 2);
+	CU_ASSERT_EQUAL(blocks_budget(2 * BLOCKS_CHUNK_SIZE), 2);
+	CU_ASSERT_EQUAL(blocks_budget(64L * BLOCKS_MIN_LENGTH), 64);
+	CU_ASSERT_EQUAL(blocks_chunk_size(1024), BLOCKS_CHUNK_SIZE);
+	CU_ASSERT(1024L * 1024 * 1024 * 1024 /
+		  blocks_chunk_size(1024L * 1024 * 1024 * 1024) <
+		  BLOCKS_MAX_CHUNKS);
+
+	// Over budget, the blocks that gain the least are merged anyway
+	frequency_t chunks[BLOCKS_TEST_CHUNKS * HUFFMAN_MAX_SYMBOLS];
+	blocks_test_chunks(chunks, 3);
+	blocks_t blocks;
+	CU_ASSERT_EQUAL_FATAL(blocks_split(chunks, BLOCKS_TEST_CHUNKS,
+					   BLOCKS_CHUNK_SIZE,
+					   BLOCKS_TEST_CHUNKS *
+					   BLOCKS_CHUNK_SIZE, 1, &blocks), 0);
+	CU_ASSERT_EQUAL(blocks.count, 1);
+	blocks_destroy(&blocks);
+}
+
+void test_blocks_roundtrip(void)
+{
+	// A few chunks are enough to split
+	long length = 8 * BLOCKS_CHUNK_SIZE;
+	unsigned char *data = malloc(length);
+	unsigned char *decoded = malloc(length);
+	long text = length / 2;
+	unsigned int state = 7;
+	for (long i = 0; i < length; i++) {
+		state = state * 1103515245 + 12345;
+		data[i] = i < text ? 'a' + (state >> 16) % 4 :
+		    (state >> 16) & 0xff;
+	}
+
+	FILE *input = tmpfile();
+	fwrite(data, 1, length, input);
+	FILE *compressed = tmpfile();
+
+	codec_t codec;
+	codec_create(&codec);
+	CU_ASSERT_TRUE(blocks_eligible(input, length));
+	CU_ASSERT_EQUAL(compress_stream(input, compressed,
+					COMPRESSION_LEVEL_NORMAL,
+					TRANSFORM_NONE, &codec), 0);
+
+	rewind(compressed);
+	stream_header_t header;
+	frequency_table_t frequency_table = NULL;
+	CU_ASSERT_EQUAL_FATAL(read_compressed_file
+			      (compressed, &header, &frequency_table), 0);
+	CU_ASSERT_EQUAL(header.file_length, length);
+	CU_ASSERT(header.block_count > 1);
+
+	// The text costs two bits a byte, the rest eight
+	fseek(compressed, 0, SEEK_END);
+	CU_ASSERT(ftell(compressed) < text / 4 + (length - text) + 4096);
+
+	codec_prepare(&codec, frequency_table);
+	output_t output;
+	output_open_buffer(&output, decoded, length);
+	CU_ASSERT_EQUAL(write_file(compressed, &output, &header, &codec), 0);
+	CU_ASSERT_EQUAL(memcmp(data, decoded, length), 0);
+	frequencies_destroy(&frequency_table);
+	codec_destroy(&codec);
+
+	// A stream of blocks lists at least one
+	rewind(compressed);
+	unsigned int count = 0;
+	fseek(compressed, HUFFMAN_MAGIC_SIZE + HUFFMAN_FILE_LENGTH_SIZE,
+	      SEEK_SET);
+	fwrite(&count, sizeof(count), 1, compressed);
+	rewind(compressed);
+	CU_ASSERT_EQUAL(read_compressed_file
+			(compressed, &header, &frequency_table), -1);
+	frequencies_destroy(&frequency_table);
+
+	fclose(input);
+	fclose(compressed);
+	free(data);
+	free(decoded);
+}
+
+void test_blocks_automatic(void)
+{
+	// Two halves over distinct skewed alphabets: move-to-front codes
+	// them smaller than a single table does, blocks smaller still
+	long length = 2 * BLOCKS_MIN_LENGTH;
+	FILE *input = tmpfile();
+	unsigned int state = 11;
+	for (long i = 0; i < length; i++) {
+		int symbol = 0;
+		do {
+			state = state * 1103515245 + 12345;
+		} while ((state >> 16) & 1 && ++symbol < 31);
+		fputc((i < length / 2 ? 0 : 128) + symbol, input);
+	}
+	CU_ASSERT_NOT_EQUAL(transform_select(input, 0, length),
+			    TRANSFORM_NONE);
+
+	FILE *compressed = tmpfile();
+	codec_t codec;
+	codec_create(&codec);
+	CU_ASSERT_EQUAL(compress_stream(input, compressed,
+					COMPRESSION_LEVEL_NORMAL,
+					TRANSFORM_AUTO, &codec), 0);
+
+	rewind(compressed);
+	stream_header_t header;
+	frequency_table_t frequency_table = NULL;
+	CU_ASSERT_EQUAL_FATAL(read_compressed_file
+			      (compressed, &header, &frequency_table), 0);
+	CU_ASSERT(header.block_count > 1);
+	CU_ASSERT_EQUAL(header.filters, TRANSFORM_NONE);
+
+	frequencies_destroy(&frequency_table);
+	codec_destroy(&codec);
+	fclose(input);
+	fclose(compressed);
+}
@@ -0,0 +1,77 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "huffman/dispatch.h"
+#include "huffman/histogram.h"
+#include "huffman/statistics.h"
+#include "dispatch_test.h"
+
+void test_cpu_variant_parse(void)
+{
+	cpu_variant_t variant;
+
+	for (int i = 0; i < CPU_VARIANT_COUNT; i++) {
+		CU_ASSERT_EQUAL(cpu_variant_parse(cpu_variant_name(i),
+						  &variant), 0);
+		CU_ASSERT_EQUAL(variant, i);
+	}
+
+	CU_ASSERT_EQUAL(cpu_variant_parse("neon", &variant), -1);
+	CU_ASSERT_STRING_EQUAL(cpu_variant_name(CPU_VARIANT_COUNT), "unknown");
+}
+
+void test_dispatch_select(void)
+{
+	cpu_variant_t initial = dispatch_variant();
+	CU_ASSERT_TRUE(cpu_variant_supported(initial));
+	CU_ASSERT_TRUE(cpu_variant_supported(CPU_VARIANT_SCALAR));
+
+	CU_ASSERT_EQUAL(dispatch_select(CPU_VARIANT_SCALAR), 0);
+	CU_ASSERT_EQUAL(dispatch_variant(), CPU_VARIANT_SCALAR);
+	CU_ASSERT_EQUAL(dispatch_select(CPU_VARIANT_COUNT), -1);
+	CU_ASSERT_EQUAL(dispatch_variant(), CPU_VARIANT_SCALAR);
+
+	CU_ASSERT_EQUAL(dispatch_select(initial), 0);
+}
+
+void test_histogram_kernels_identical(void)
+{
+	size_t size = 3 * HISTOGRAM_BUFFER_SIZE + 13;
+	unsigned char *buffer = malloc(size);
+	CU_ASSERT_PTR_NOT_NULL(buffer);
+
+	// Random bytes, then long runs of one byte
+	srand(42);
+	for (size_t i = 0; i < size; i++) {
+		buffer[i] = i < size / 2 ? rand() : (i / 4096) % 3;
+	}
+
+	frequency_t expected[HUFFMAN_MAX_SYMBOLS];
+	frequency_t actual[HUFFMAN_MAX_SYMBOLS];
+	size_t lengths[] = { 0, 1, 3, 4, 5, 63, 64, 65, size / 2, size };
+
+	for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+		// Unaligned start and tail
+		const unsigned char *start = buffer + (l > 0 ? 1 : 0);
+		size_t length = lengths[l] - (l > 0 && lengths[l] == size);
+
+		memset(expected, 0, sizeof(expected));
+		for (size_t i = 0; i < length; i++) {
+			expected[start[i]]++;
+		}
+
+		for (int v = 0; v < CPU_VARIANT_COUNT; v++) {
+			if (!cpu_variant_supported(v))
+				continue;
+
+			memset(actual, 0, sizeof(actual));
+			histogram_kernel(v) (start, length, actual);
+			CU_ASSERT_EQUAL(memcmp(expected, actual,
+					       sizeof(expected)), 0);
+		}
+	}
+
+	free(buffer);
+}
@@ -0,0 +1,269 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "huffman/histogram.h"
+#include "huffman/huffman.h"
+#include "huffman/memory.h"
+#include "huffman/statistics.h"
+#include "histogram_test.h"
+
+void test_compression_level_parse(void)
+{
+	compression_level_t level = COMPRESSION_LEVEL_NORMAL;
+
+	CU_ASSERT_EQUAL(compression_level_parse("fast", &level), 0);
+	CU_ASSERT_EQUAL(level, COMPRESSION_LEVEL_FAST);
+
+	CU_ASSERT_EQUAL(compression_level_parse("normal", &level), 0);
+	CU_ASSERT_EQUAL(level, COMPRESSION_LEVEL_NORMAL);
+
+	CU_ASSERT_EQUAL(compression_level_parse("1", &level), 0);
+	CU_ASSERT_EQUAL(level, COMPRESSION_LEVEL_FAST);
+
+	CU_ASSERT_EQUAL(compression_level_parse("best", &level), -1);
+	CU_ASSERT_EQUAL(level, COMPRESSION_LEVEL_FAST);
+}
+
+void test_histogram_count_buffer(void)
+{
+	frequency_table_t table = NULL;
+	frequencies_create(&table);
+
+	const unsigned char buffer[] = "abracadabra";
+	histogram_count_buffer(buffer, sizeof(buffer) - 1, table);
+
+	CU_ASSERT_EQUAL(frequencies_get(table, 'a'), 5);
+	CU_ASSERT_EQUAL(frequencies_get(table, 'b'), 2);
+	CU_ASSERT_EQUAL(frequencies_get(table, 'r'), 2);
+	CU_ASSERT_EQUAL(frequencies_get(table, 'c'), 1);
+	CU_ASSERT_EQUAL(frequencies_get(table, 'd'), 1);
+	CU_ASSERT_EQUAL(frequencies_get(table, 'z'), 0);
+
+	frequencies_destroy(&table);
+}
+
+void test_histogram_count_unaligned(void)
+{
+	size_t size = 3 * HISTOGRAM_BUFFER_SIZE + 13;
+	unsigned char *buffer = malloc(size);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(buffer);
+
+	// Random bytes, then long runs of one byte
+	srand(42);
+	for (size_t i = 0; i < size; i++) {
+		buffer[i] = i < size / 2 ? rand() : (i / 4096) % 3;
+	}
+
+	frequency_t expected[HUFFMAN_MAX_SYMBOLS];
+	frequency_t actual[HUFFMAN_MAX_SYMBOLS];
+	size_t lengths[] = { 0, 1, 7, 8, 9, 63, 64, 65, size / 2, size };
+
+	for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+		// Unaligned start and tail
+		const unsigned char *start = buffer + (l > 0 ? 1 : 0);
+		size_t length = lengths[l] - (l > 0 && lengths[l] == size);
+
+		memset(expected, 0, sizeof(expected));
+		for (size_t i = 0; i < length; i++) {
+			expected[start[i]]++;
+		}
+
+		memset(actual, 0, sizeof(actual));
+		histogram_count_buffer(start, length, actual);
+		CU_ASSERT_EQUAL(memcmp(expected, actual, sizeof(expected)), 0);
+	}
+
+	free(buffer);
+}
+
+void test_histogram_count(void)
+{
+	FILE *file = tmpfile();
+	CU_ASSERT_PTR_NOT_NULL(file);
+
+	for (int i = 0; i < 3 * HISTOGRAM_BUFFER_SIZE; i++) {
+		fputc(i % 3, file);
+	}
+	rewind(file);
+
+	frequency_table_t table = NULL;
+	frequencies_create(&table);
+
+	CU_ASSERT_EQUAL(histogram_count(file, table), 0);
+	CU_ASSERT_EQUAL(frequencies_get(table, 0), HISTOGRAM_BUFFER_SIZE);
+	CU_ASSERT_EQUAL(frequencies_get(table, 1), HISTOGRAM_BUFFER_SIZE);
+	CU_ASSERT_EQUAL(frequencies_get(table, 2), HISTOGRAM_BUFFER_SIZE);
+	CU_ASSERT_EQUAL(frequencies_get(table, 3), 0);
+
+	frequencies_destroy(&table);
+	fclose(file);
+}
+
+void test_histogram_count_chunks(void)
+{
+	size_t chunk_size = 1000;
+	long length = 5 * chunk_size + 123;
+	unsigned char *data = malloc(length);
+	for (long i = 0; i < length; i++) {
+		data[i] = i / chunk_size + (i & 1);
+	}
+
+	FILE *file = tmpfile();
+	fwrite(data, 1, length, file);
+	fflush(file);
+
+	// Every chunk gets its own counts, whatever the threads' ranges
+	for (int threads = 1; threads <= 8; threads++) {
+		frequency_t *chunks = calloc(6, HUFFMAN_MAX_SYMBOLS *
+					     sizeof(frequency_t));
+		CU_ASSERT_EQUAL(histogram_count_chunks
+				(fileno(file), 0, length, chunk_size, threads,
+				 chunks), 0);
+		for (int k = 0; k < 6; k++) {
+			frequency_t *table = chunks + k * HUFFMAN_MAX_SYMBOLS;
+			frequency_t expected = k < 5 ? chunk_size / 2 : 123 / 2;
+			CU_ASSERT_EQUAL(table[k], expected + (k < 5 ? 0 : 1));
+			CU_ASSERT_EQUAL(table[k + 1], expected);
+		}
+		free(chunks);
+	}
+
+	// Chunks are numbered from `start`
+	frequency_t *chunks = calloc(2, HUFFMAN_MAX_SYMBOLS *
+				     sizeof(frequency_t));
+	CU_ASSERT_EQUAL(histogram_count_chunks(fileno(file), 4 * chunk_size,
+					       length, chunk_size, 2, chunks),
+			0);
+	CU_ASSERT_EQUAL(chunks[4], chunk_size / 2);
+	CU_ASSERT_EQUAL(chunks[HUFFMAN_MAX_SYMBOLS + 5], 62);
+	free(chunks);
+
+	fclose(file);
+	free(data);
+}
+
+void test_histogram_sample_small(void)
+{
+	FILE *file = tmpfile();
+	CU_ASSERT_PTR_NOT_NULL(file);
+
+	fputs("hello, world", file);
+	rewind(file);
+
+	frequency_table_t table = NULL;
+	frequencies_create(&table);
+
+	CU_ASSERT_EQUAL(histogram_build(file, COMPRESSION_LEVEL_FAST, table),
+			0);
+	CU_ASSERT_EQUAL(frequencies_get(table, 'l'), 3);
+	CU_ASSERT_EQUAL(frequencies_get(table, 'o'), 2);
+	CU_ASSERT_EQUAL(frequencies_get(table, 'z'), 0);
+
+	frequencies_destroy(&table);
+	fclose(file);
+}
+
+void test_histogram_sample_escape(void)
+{
+	FILE *file = tmpfile();
+	CU_ASSERT_PTR_NOT_NULL(file);
+
+	unsigned char *buffer = malloc(HISTOGRAM_BUFFER_SIZE);
+	memset(buffer, 'a', HISTOGRAM_BUFFER_SIZE);
+	// The first byte is never part of a sample
+	buffer[0] = 'z';
+
+	long length = 0;
+	while (length < HISTOGRAM_SAMPLE_THRESHOLD) {
+		fwrite(buffer, 1, HISTOGRAM_BUFFER_SIZE, file);
+		buffer[0] = 'a';
+		length += HISTOGRAM_BUFFER_SIZE;
+	}
+	rewind(file);
+	free(buffer);
+
+	frequency_table_t table = NULL;
+	frequencies_create(&table);
+
+	CU_ASSERT_EQUAL(histogram_build(file, COMPRESSION_LEVEL_FAST, table),
+			0);
+	CU_ASSERT_EQUAL(frequencies_get(table, 'a'), (frequency_t) length);
+	CU_ASSERT_EQUAL(frequencies_get(table, 'z'), 1);
+	for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++) {
+		CU_ASSERT_NOT_EQUAL(frequencies_get(table, i), 0);
+	}
+
+	frequencies_destroy(&table);
+	fclose(file);
+}
+
+void test_histogram_count_parallel(void)
+{
+	long length = 2 * HISTOGRAM_PARALLEL_MIN + 12345;
+	unsigned char *data = malloc(length);
+	unsigned int state = 3;
+	for (long i = 0; i < length; i++) {
+		state = state * 1103515245 + 12345;
+		data[i] = (state >> 16) % (1 + (i >> 20) % 200);
+	}
+
+	FILE *file = tmpfile();
+	fwrite(data, 1, length, file);
+	fflush(file);
+
+	frequency_t reference[HUFFMAN_MAX_SYMBOLS] = { 0 };
+	for (long i = 0; i < length; i++) {
+		reference[data[i]]++;
+	}
+
+	// Any number of ranges, including uneven and empty ones
+	for (int threads = 1; threads <= 7; threads++) {
+		frequency_t table[HUFFMAN_MAX_SYMBOLS] = { 0 };
+		CU_ASSERT_EQUAL(histogram_count_parallel
+				(fileno(file), 0, length, threads, table), 0);
+		CU_ASSERT_EQUAL(memcmp(table, reference, sizeof(table)), 0);
+	}
+
+	frequency_t table[HUFFMAN_MAX_SYMBOLS] = { 0 };
+	CU_ASSERT_EQUAL(histogram_count_parallel
+			(fileno(file), 0, 3, 8, table), 0);
+	frequency_t total = 0;
+	for (int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++) {
+		total += table[i];
+	}
+	CU_ASSERT_EQUAL(total, 3);
+
+	// histogram_count splits from the current position when allowed
+	// several threads
+	memory_configure(0, 4);
+	fseek(file, 1000, SEEK_SET);
+	memset(table, 0, sizeof(table));
+	CU_ASSERT_EQUAL(histogram_count(file, table), 0);
+	CU_ASSERT_EQUAL(ftell(file), length);
+	for (long i = 0; i < 1000; i++) {
+		table[data[i]]++;
+	}
+	CU_ASSERT_EQUAL(memcmp(table, reference, sizeof(table)), 0);
+
+	// Ranges stop short of the end, in parallel or not, and fail past it
+	for (int threads = 1; threads <= 4; threads += 3) {
+		memory_configure(0, threads);
+		long end = length - 1000;
+		memset(table, 0, sizeof(table));
+		CU_ASSERT_EQUAL(histogram_count_range(file, 0, end, table), 0);
+		CU_ASSERT_EQUAL(ftell(file), end);
+		for (long i = end; i < length; i++) {
+			table[data[i]]++;
+		}
+		CU_ASSERT_EQUAL(memcmp(table, reference, sizeof(table)), 0);
+		CU_ASSERT_EQUAL(histogram_count_range
+				(file, 1000, length, table), -1);
+	}
+	memory_configure(0, 1);
+
+	fclose(file);
+	free(data);
+}
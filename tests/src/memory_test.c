@@ -0,0 +1,106 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "huffman/memory.h"
+#include "memory_test.h"
+
+void test_memory_parse_size(void)
+{
+	size_t size = 0;
+
+	CU_ASSERT_EQUAL(memory_parse_size("1024", &size), 0);
+	CU_ASSERT_EQUAL(size, 1024);
+	CU_ASSERT_EQUAL(memory_parse_size("64K", &size), 0);
+	CU_ASSERT_EQUAL(size, 64 * 1024);
+	CU_ASSERT_EQUAL(memory_parse_size("64M", &size), 0);
+	CU_ASSERT_EQUAL(size, 64 * 1024 * 1024);
+	CU_ASSERT_EQUAL(memory_parse_size("1.5GiB", &size), 0);
+	CU_ASSERT_EQUAL(size, (size_t)3 * 512 * 1024 * 1024);
+	CU_ASSERT_EQUAL(memory_parse_size("0", &size), 0);
+	CU_ASSERT_EQUAL(size, 0);
+
+	CU_ASSERT_EQUAL(memory_parse_size("", &size), -1);
+	CU_ASSERT_EQUAL(memory_parse_size("12T", &size), -1);
+	CU_ASSERT_EQUAL(memory_parse_size("-1M", &size), -1);
+	CU_ASSERT_EQUAL(memory_parse_size("inf", &size), -1);
+	CU_ASSERT_EQUAL(memory_parse_size("nan", &size), -1);
+	CU_ASSERT_EQUAL(memory_parse_size("-nanK", &size), -1);
+	CU_ASSERT_EQUAL(memory_parse_size("1e300", &size), -1);
+	CU_ASSERT_EQUAL(memory_parse_size("17179869184G", &size), -1);
+	CU_ASSERT_EQUAL(memory_parse_size("1e308G", &size), -1);
+}
+
+void test_memory_configure(void)
+{
+	const memory_plan_t *plan = memory_configure(0, 1);
+	CU_ASSERT_EQUAL(plan->buffer_size, MEMORY_BUFFER_MAX);
+	CU_ASSERT_EQUAL(plan->map_limit, SIZE_MAX);
+	CU_ASSERT_PTR_EQUAL(plan, memory_plan());
+
+	plan = memory_configure(64 * 1024 * 1024, 1);
+	CU_ASSERT_EQUAL(plan->buffer_size, MEMORY_BUFFER_MAX);
+	CU_ASSERT_EQUAL(plan->threads, 1);
+	CU_ASSERT(plan->map_limit < 64 * 1024 * 1024);
+
+	// Buffers shrink before the limit is exceeded
+	plan = memory_configure(MEMORY_BASELINE + 512 * 1024, 1);
+	CU_ASSERT_EQUAL(plan->buffer_size, 128 * 1024);
+	CU_ASSERT(MEMORY_BUFFERS_PER_THREAD * plan->buffer_size <=
+		  512 * 1024);
+
+	memory_configure(0, 1);
+}
+
+void test_memory_degrade(void)
+{
+	// Fewer threads rather than buffers below the preferred size
+	const memory_plan_t *plan =
+	    memory_configure(MEMORY_BASELINE + 1024 * 1024, 8);
+	CU_ASSERT_EQUAL(plan->threads, 4);
+	CU_ASSERT_EQUAL(plan->buffer_size, MEMORY_BUFFER_PREFERRED);
+
+	// Then smaller buffers on a single thread
+	plan = memory_configure(MEMORY_BASELINE + 32 * 1024, 8);
+	CU_ASSERT_EQUAL(plan->threads, 1);
+	CU_ASSERT_EQUAL(plan->buffer_size, 8 * 1024);
+
+	// A limit below the baseline still runs, with the smallest buffers
+	plan = memory_configure(1024, 8);
+	CU_ASSERT_EQUAL(plan->threads, 1);
+	CU_ASSERT_EQUAL(plan->buffer_size, MEMORY_BUFFER_MIN);
+	CU_ASSERT_EQUAL(plan->map_limit, 0);
+
+	memory_configure(0, 1);
+}
+
+void test_memory_phases(void)
+{
+	CU_ASSERT(memory_peak() > 0);
+
+	memory_phases_start();
+
+	size_t size = 16 * 1024 * 1024;
+	char *block = malloc(size);
+	memset(block, 1, size);
+	memory_phase_end("large");
+	free(block);
+	memory_phase_end("small");
+
+	char *report = NULL;
+	size_t length = 0;
+	FILE *stream = tmpfile();
+	memory_phases_report(stream);
+	length = ftell(stream);
+	rewind(stream);
+	report = calloc(length + 1, 1);
+	CU_ASSERT_EQUAL(fread(report, 1, length, stream), length);
+	fclose(stream);
+
+	CU_ASSERT_NSTRING_EQUAL(report, "Peak memory: large ", 19);
+	CU_ASSERT_PTR_NOT_NULL(strstr(report, ", small "));
+	free(report);
+}
@@ -0,0 +1,175 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "huffman/output.h"
+#include "output_test.h"
+
+static char *output_test_filename(void)
+{
+	static char filename[] = "/tmp/huffman_output_XXXXXX";
+	strcpy(filename + strlen(filename) - 6, "XXXXXX");
+
+	int fd = mkstemp(filename);
+	if (fd >= 0)
+		close(fd);
+
+	return filename;
+}
+
+static long output_test_read(const char *filename, char *buffer, long size)
+{
+	FILE *file = fopen(filename, "r");
+	if (NULL == file)
+		return -1;
+
+	long length = fread(buffer, 1, size, file);
+	fclose(file);
+
+	return length;
+}
+
+void test_output_mapped(void)
+{
+	char *filename = output_test_filename();
+	output_t output;
+
+	CU_ASSERT_EQUAL(output_open(&output, filename, 5), 0);
+	CU_ASSERT_TRUE(output_is_mapped(&output));
+
+	const char *text = "hello";
+	for (int i = 0; i < 5; i++) {
+		output_put(&output, text[i]);
+	}
+	CU_ASSERT_EQUAL(output_close(&output), 0);
+
+	char buffer[16] = { 0 };
+	CU_ASSERT_EQUAL(output_test_read(filename, buffer, sizeof(buffer)), 5);
+	CU_ASSERT_NSTRING_EQUAL(buffer, "hello", 5);
+
+	unlink(filename);
+}
+
+void test_output_region(void)
+{
+	char *filename = output_test_filename();
+	output_t output;
+
+	CU_ASSERT_EQUAL(output_open(&output, filename, 8), 0);
+
+	unsigned char *tail = output_region(&output, 4, 4);
+	unsigned char *head = output_region(&output, 0, 4);
+	CU_ASSERT_PTR_NOT_NULL(head);
+	CU_ASSERT_PTR_NOT_NULL(tail);
+	CU_ASSERT_PTR_NULL(output_region(&output, 6, 4));
+
+	memcpy(tail, "5678", 4);
+	memcpy(head, "1234", 4);
+	output.position = 8;
+	CU_ASSERT_EQUAL(output_close(&output), 0);
+
+	char buffer[16] = { 0 };
+	CU_ASSERT_EQUAL(output_test_read(filename, buffer, sizeof(buffer)), 8);
+	CU_ASSERT_NSTRING_EQUAL(buffer, "12345678", 8);
+
+	unlink(filename);
+}
+
+void test_output_overflow(void)
+{
+	unsigned char buffer[6] = "....!!";
+	output_t output;
+
+	// Bytes past the length are dropped, and the output fails
+	CU_ASSERT_EQUAL(output_open_buffer(&output, buffer, 4), 0);
+	const char *text = "abcdef";
+	for (int i = 0; i < 6; i++) {
+		output_put(&output, text[i]);
+	}
+	CU_ASSERT_EQUAL(output.position, 6);
+	CU_ASSERT_EQUAL(memcmp(buffer, "abcd!!", 6), 0);
+	CU_ASSERT_EQUAL(output_close(&output), -1);
+}
+
+void test_output_short(void)
+{
+	char *filename = output_test_filename();
+	output_t output;
+
+	CU_ASSERT_EQUAL(output_open(&output, filename, 1024), 0);
+	output_put(&output, 'a');
+	output_put(&output, 'b');
+	CU_ASSERT_EQUAL(output_close(&output), 0);
+
+	char buffer[16] = { 0 };
+	CU_ASSERT_EQUAL(output_test_read(filename, buffer, sizeof(buffer)), 2);
+
+	unlink(filename);
+}
+
+void test_output_buffered(void)
+{
+	output_t output;
+
+	CU_ASSERT_EQUAL(output_open(&output, "/dev/null", 3), 0);
+	CU_ASSERT_FALSE(output_is_mapped(&output));
+	CU_ASSERT_PTR_NULL(output_region(&output, 0, 1));
+
+	output_put(&output, 'a');
+	output_put(&output, 'b');
+	output_put(&output, 'c');
+	CU_ASSERT_EQUAL(output.position, 3);
+	CU_ASSERT_EQUAL(output_close(&output), 0);
+
+	char *filename = output_test_filename();
+	CU_ASSERT_EQUAL(output_open(&output, filename, 0), 0);
+	CU_ASSERT_FALSE(output_is_mapped(&output));
+	CU_ASSERT_EQUAL(output_close(&output), 0);
+
+	unlink(filename);
+}
+
+void test_output_direct(void)
+{
+	// Several buffers and an unaligned tail, part put and part written
+	long size = 2 * OUTPUT_BUFFER_SIZE + OUTPUT_DIRECT_ALIGNMENT + 777;
+	char *expected = malloc(size);
+	for (long i = 0; i < size; i++) {
+		expected[i] = (char)(i * 13 + 5);
+	}
+
+	// Reserved larger than written: the file is trimmed on close
+	char *filename = output_test_filename();
+	output_t output;
+	CU_ASSERT_EQUAL_FATAL(output_open_direct(&output, filename, size + 5000),
+			      0);
+	CU_ASSERT_FALSE(output_is_mapped(&output));
+	long half = size / 2 + 3;
+	for (long i = 0; i < half; i++) {
+		output_put(&output, expected[i]);
+	}
+	CU_ASSERT_EQUAL(output_write(&output, (unsigned char *)expected + half,
+				     size - half), 0);
+	CU_ASSERT_EQUAL(output.position, size);
+	CU_ASSERT_EQUAL(output_close(&output), 0);
+
+	char *buffer = malloc(size + 1);
+	CU_ASSERT_EQUAL(output_test_read(filename, buffer, size + 1), size);
+	CU_ASSERT_EQUAL(memcmp(buffer, expected, size), 0);
+
+	// Shorter than one block
+	CU_ASSERT_EQUAL_FATAL(output_open_direct(&output, filename, 0), 0);
+	CU_ASSERT_EQUAL(output_write(&output, (unsigned char *)"abc", 3), 0);
+	CU_ASSERT_EQUAL(output_close(&output), 0);
+	CU_ASSERT_EQUAL(output_test_read(filename, buffer, size), 3);
+	CU_ASSERT_EQUAL(memcmp(buffer, "abc", 3), 0);
+
+	unlink(filename);
+	free(buffer);
+	free(expected);
+}
@@ -2,7 +2,18 @@
 #include <CUnit/Basic.h>
 #include <stdlib.h>
 
+#include "analysis_test.h"
+#include "archive_test.h"
+#include "blocks_test.h"
+#include "bitstream_test.h"
+#include "dispatch_test.h"
+#include "histogram_test.h"
+#include "memory_test.h"
+#include "output_test.h"
+#include "segments_test.h"
+#include "server_test.h"
 #include "statistics_test.h"
+#include "transform_test.h"
 
 int init_suite(void)
 {
@@ -42,6 +53,242 @@ int main(void)
 		return CU_get_error();
 	}
 
+	pSuite = CU_add_suite("Histogram", init_suite, clean_suite);
+	if (NULL == pSuite) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (NULL ==
+	    CU_add_test(pSuite, "test_compression_level_parse",
+			test_compression_level_parse)
+	    || NULL == CU_add_test(pSuite, "test_histogram_count_buffer",
+				   test_histogram_count_buffer)
+	    || NULL == CU_add_test(pSuite, "test_histogram_count",
+				   test_histogram_count)
+	    || NULL == CU_add_test(pSuite, "test_histogram_count_parallel",
+				   test_histogram_count_parallel)
+	    || NULL == CU_add_test(pSuite, "test_histogram_count_chunks",
+				   test_histogram_count_chunks)
+	    || NULL == CU_add_test(pSuite, "test_histogram_count_unaligned",
+				   test_histogram_count_unaligned)
+	    || NULL == CU_add_test(pSuite, "test_histogram_sample_small",
+				   test_histogram_sample_small)
+	    || NULL == CU_add_test(pSuite, "test_histogram_sample_escape",
+				   test_histogram_sample_escape)) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	pSuite = CU_add_suite("Output", init_suite, clean_suite);
+	if (NULL == pSuite) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (NULL ==
+	    CU_add_test(pSuite, "test_output_mapped", test_output_mapped)
+	    || NULL == CU_add_test(pSuite, "test_output_region",
+				   test_output_region)
+	    || NULL == CU_add_test(pSuite, "test_output_overflow",
+				   test_output_overflow)
+	    || NULL == CU_add_test(pSuite, "test_output_short",
+				   test_output_short)
+	    || NULL == CU_add_test(pSuite, "test_output_buffered",
+				   test_output_buffered)
+	    || NULL == CU_add_test(pSuite, "test_output_direct",
+				   test_output_direct)) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	pSuite = CU_add_suite("Bitstream", init_suite, clean_suite);
+	if (NULL == pSuite) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (NULL ==
+	    CU_add_test(pSuite, "test_bit_writer_padding",
+			test_bit_writer_padding)
+	    || NULL == CU_add_test(pSuite, "test_bit_writer_large",
+				   test_bit_writer_large)
+	    || NULL == CU_add_test(pSuite, "test_bit_writer_failed",
+				   test_bit_writer_failed)
+	    || NULL == CU_add_test(pSuite, "test_bit_reader_peek_consume",
+				   test_bit_reader_peek_consume)
+	    || NULL == CU_add_test(pSuite, "test_bit_reader_past_end",
+				   test_bit_reader_past_end)
+	    || NULL == CU_add_test(pSuite, "test_bitstream_roundtrip",
+				   test_bitstream_roundtrip)
+	    || NULL == CU_add_test(pSuite, "test_encoding_pack",
+				   test_encoding_pack)
+	    || NULL == CU_add_test(pSuite, "test_encoding_pair",
+				   test_encoding_pair)) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	pSuite = CU_add_suite("Dispatch", init_suite, clean_suite);
+	if (NULL == pSuite) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (NULL ==
+	    CU_add_test(pSuite, "test_cpu_variant_parse",
+			test_cpu_variant_parse)
+	    || NULL == CU_add_test(pSuite, "test_dispatch_select",
+				   test_dispatch_select)
+	    || NULL == CU_add_test(pSuite, "test_histogram_kernels_identical",
+				   test_histogram_kernels_identical)) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	pSuite = CU_add_suite("Server", init_suite, clean_suite);
+	if (NULL == pSuite) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (NULL ==
+	    CU_add_test(pSuite, "test_server_roundtrip",
+			test_server_roundtrip)
+	    || NULL == CU_add_test(pSuite, "test_server_errors",
+				   test_server_errors)
+	    || NULL == CU_add_test(pSuite, "test_server_stats",
+				   test_server_stats)
+	    || NULL == CU_add_test(pSuite, "test_server_memory_limit",
+				   test_server_memory_limit)
+	    || NULL == CU_add_test(pSuite, "test_server_max_payload",
+				   test_server_max_payload)
+	    || NULL == CU_add_test(pSuite, "test_server_connections",
+				   test_server_connections)
+	    || NULL == CU_add_test(pSuite, "test_server_path",
+				   test_server_path)) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	pSuite = CU_add_suite("Memory", init_suite, clean_suite);
+	if (NULL == pSuite) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (NULL ==
+	    CU_add_test(pSuite, "test_memory_parse_size",
+			test_memory_parse_size)
+	    || NULL == CU_add_test(pSuite, "test_memory_configure",
+				   test_memory_configure)
+	    || NULL == CU_add_test(pSuite, "test_memory_degrade",
+				   test_memory_degrade)
+	    || NULL == CU_add_test(pSuite, "test_memory_phases",
+				   test_memory_phases)) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	pSuite = CU_add_suite("Transform", init_suite, clean_suite);
+	if (NULL == pSuite) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (NULL ==
+	    CU_add_test(pSuite, "test_transform_parse", test_transform_parse)
+	    || NULL == CU_add_test(pSuite, "test_transform_rle",
+				   test_transform_rle)
+	    || NULL == CU_add_test(pSuite, "test_transform_roundtrip",
+				   test_transform_roundtrip)
+	    || NULL == CU_add_test(pSuite, "test_transform_select",
+				   test_transform_select)
+	    || NULL == CU_add_test(pSuite, "test_transform_compress_stream",
+				   test_transform_compress_stream)) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	pSuite = CU_add_suite("Archive", init_suite, clean_suite);
+	if (NULL == pSuite) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (NULL ==
+	    CU_add_test(pSuite, "test_archive_roundtrip",
+			test_archive_roundtrip)
+	    || NULL == CU_add_test(pSuite, "test_archive_extract_one",
+				   test_archive_extract_one)
+	    || NULL == CU_add_test(pSuite, "test_archive_errors",
+				   test_archive_errors)) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	pSuite = CU_add_suite("Analysis", init_suite, clean_suite);
+	if (NULL == pSuite) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (NULL ==
+	    CU_add_test(pSuite, "test_analyze_exact", test_analyze_exact)
+	    || NULL == CU_add_test(pSuite, "test_analyze_entropy",
+				   test_analyze_entropy)
+	    || NULL == CU_add_test(pSuite, "test_analyze_empty",
+				   test_analyze_empty)
+	    || NULL == CU_add_test(pSuite, "test_analyze_blocks",
+				   test_analyze_blocks)
+	    || NULL == CU_add_test(pSuite, "test_analyze_output",
+				   test_analyze_output)) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	pSuite = CU_add_suite("Segments", init_suite, clean_suite);
+	if (NULL == pSuite) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (NULL ==
+	    CU_add_test(pSuite, "test_segments_append", test_segments_append)
+	    || NULL == CU_add_test(pSuite, "test_segments_from_stream",
+				   test_segments_from_stream)
+	    || NULL == CU_add_test(pSuite, "test_segments_interrupted",
+				   test_segments_interrupted)
+	    || NULL == CU_add_test(pSuite, "test_segments_interrupted_stream",
+				   test_segments_interrupted_stream)
+	    || NULL == CU_add_test(pSuite, "test_segments_growth",
+				   test_segments_growth)
+	    || NULL == CU_add_test(pSuite, "test_segments_sampled",
+				   test_segments_sampled)
+	    || NULL == CU_add_test(pSuite, "test_segments_errors",
+				   test_segments_errors)) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	pSuite = CU_add_suite("Blocks", init_suite, clean_suite);
+	if (NULL == pSuite) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (NULL ==
+	    CU_add_test(pSuite, "test_blocks_split", test_blocks_split)
+	    || NULL == CU_add_test(pSuite, "test_blocks_budget",
+				   test_blocks_budget)
+	    || NULL == CU_add_test(pSuite, "test_blocks_roundtrip",
+				   test_blocks_roundtrip)
+	    || NULL == CU_add_test(pSuite, "test_blocks_automatic",
+				   test_blocks_automatic)) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
 	CU_basic_set_mode(CU_BRM_VERBOSE);
 	CU_basic_run_tests();
 	CU_basic_show_failures(CU_get_failure_list());
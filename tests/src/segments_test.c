@@ -0,0 +1,416 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "huffman/codec.h"
+#include "huffman/histogram.h"
+#include "huffman/huffman.h"
+#include "huffman/segments.h"
+#include "segments_test.h"
+
+static char segments_test_input[64];
+static char segments_test_output[80];
+
+static int segments_test_setup(void)
+{
+	snprintf(segments_test_input, sizeof(segments_test_input),
+		 "/tmp/huffman_segments_test_XXXXXX");
+	int fd = mkstemp(segments_test_input);
+	if (fd < 0)
+		return -1;
+	close(fd);
+
+	snprintf(segments_test_output, sizeof(segments_test_output),
+		 "%s.huff", segments_test_input);
+	unlink(segments_test_output);
+
+	return 0;
+}
+
+static void segments_test_teardown(void)
+{
+	unlink(segments_test_input);
+	unlink(segments_test_output);
+}
+
+static void segments_test_grow(const char *data, size_t length)
+{
+	FILE *file = fopen(segments_test_input, "a");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(file);
+	CU_ASSERT_EQUAL(fwrite(data, 1, length, file), length);
+	fclose(file);
+}
+
+// Decodes every segment and compares them with the whole input
+static int segments_test_check(unsigned int count, size_t length)
+{
+	FILE *file = fopen(segments_test_output, "r");
+	if (NULL == file)
+		return -1;
+
+	segments_t segments;
+	int status = segments_open(&segments, file);
+	if (0 != status) {
+		fclose(file);
+		return -1;
+	}
+
+	unsigned char *expected = malloc(length + 1);
+	unsigned char *decoded = malloc(length + 1);
+	FILE *input = fopen(segments_test_input, "r");
+	status = segments.count == count && segments.length == length
+	    && NULL != input && fread(expected, 1, length, input) == length ?
+	    0 : -1;
+
+	output_t output;
+	output_open_buffer(&output, decoded, length);
+	codec_t codec;
+	codec_create(&codec);
+	if (0 == status
+	    && (0 != segments_decode(&segments, file, &output, &codec)
+		|| output.position != length
+		|| 0 != memcmp(expected, decoded, length)))
+		status = -1;
+	codec_destroy(&codec);
+
+	if (NULL != input)
+		fclose(input);
+	free(expected);
+	free(decoded);
+	segments_close(&segments);
+	fclose(file);
+
+	return status;
+}
+
+void test_segments_append(void)
+{
+	CU_ASSERT_EQUAL_FATAL(segments_test_setup(), 0);
+
+	const char *parts[] = { "the quick brown fox ", "jumps over ",
+		"the lazy dog\n"
+	};
+	long unsigned int appended = 0;
+	size_t length = 0;
+	for (unsigned int i = 0; i < 3; i++) {
+		segments_test_grow(parts[i], strlen(parts[i]));
+		length += strlen(parts[i]);
+
+		CU_ASSERT_EQUAL(segments_append(segments_test_input,
+						segments_test_output,
+						COMPRESSION_LEVEL_NORMAL,
+						TRANSFORM_AUTO, &appended), 0);
+		CU_ASSERT_EQUAL(appended, strlen(parts[i]));
+		CU_ASSERT_EQUAL(segments_test_check(i + 1, length), 0);
+	}
+
+	// Nothing new: the file is left as it is
+	CU_ASSERT_EQUAL(segments_append(segments_test_input,
+					segments_test_output,
+					COMPRESSION_LEVEL_NORMAL,
+					TRANSFORM_AUTO, &appended), 0);
+	CU_ASSERT_EQUAL(appended, 0);
+	CU_ASSERT_EQUAL(segments_test_check(3, length), 0);
+
+	segments_test_teardown();
+}
+
+void test_segments_from_stream(void)
+{
+	CU_ASSERT_EQUAL_FATAL(segments_test_setup(), 0);
+
+	// A plain compressed file becomes the first segment
+	segments_test_grow("abracadabra", 11);
+	FILE *input = fopen(segments_test_input, "r");
+	FILE *output = fopen(segments_test_output, "w");
+	codec_t codec;
+	codec_create(&codec);
+	CU_ASSERT_EQUAL(compress_stream(input, output,
+					COMPRESSION_LEVEL_NORMAL,
+					TRANSFORM_NONE, &codec), 0);
+	codec_destroy(&codec);
+	fclose(input);
+	fclose(output);
+	CU_ASSERT_EQUAL(segments_test_check(1, 11), 0);
+
+	segments_test_grow("aaaaaaaaaaaaaaaab", 17);
+	long unsigned int appended = 0;
+	CU_ASSERT_EQUAL(segments_append(segments_test_input,
+					segments_test_output,
+					COMPRESSION_LEVEL_FAST,
+					TRANSFORM_NONE, &appended), 0);
+	CU_ASSERT_EQUAL(appended, 17);
+	CU_ASSERT_EQUAL(segments_test_check(2, 28), 0);
+
+	segments_test_teardown();
+}
+
+// Leaves the mark of an append interrupted after `garbage`
+static void segments_test_interrupt(const char *garbage, size_t length,
+				    long unsigned int covered,
+				    unsigned int count)
+{
+	FILE *file = fopen(segments_test_output, "a");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(file);
+	long unsigned int end = ftell(file);
+	fwrite(garbage, 1, length, file);
+	fwrite(&end, sizeof(end), 1, file);
+	fwrite(&covered, sizeof(covered), 1, file);
+	fwrite(&count, sizeof(count), 1, file);
+	fwrite(SEGMENTS_PENDING, 1, SEGMENTS_MAGIC_SIZE, file);
+	fclose(file);
+}
+
+void test_segments_interrupted(void)
+{
+	CU_ASSERT_EQUAL_FATAL(segments_test_setup(), 0);
+
+	long unsigned int appended = 0;
+	for (int i = 0; i < 2; i++) {
+		segments_test_grow("abracadabra", 11);
+		CU_ASSERT_EQUAL(segments_append(segments_test_input,
+						segments_test_output,
+						COMPRESSION_LEVEL_NORMAL,
+						TRANSFORM_NONE, &appended), 0);
+	}
+	struct stat info;
+	CU_ASSERT_EQUAL_FATAL(stat(segments_test_output, &info), 0);
+	off_t size = info.st_size;
+
+	// An append stopped before its trailer: a partial segment, holding
+	// the magic itself, then the mark
+	segments_test_interrupt("HUFF\x05HUFS\x01", 10, 22, 2);
+
+	// The segments before it are still read
+	FILE *file = fopen(segments_test_output, "r");
+	CU_ASSERT(segments_present(file));
+	fclose(file);
+	CU_ASSERT_EQUAL(segments_test_check(2, 22), 0);
+
+	// The next append drops it, and the previous segments are kept
+	segments_test_grow("0123456789", 10);
+	CU_ASSERT_EQUAL(segments_append(segments_test_input,
+					segments_test_output,
+					COMPRESSION_LEVEL_NORMAL,
+					TRANSFORM_NONE, &appended), 0);
+	CU_ASSERT_EQUAL(appended, 10);
+	CU_ASSERT_EQUAL(segments_test_check(3, 32), 0);
+
+	// Cut back to its size before that append, the file still holds
+	// the two segments it had then
+	CU_ASSERT_EQUAL(truncate(segments_test_output, size), 0);
+	CU_ASSERT_EQUAL(truncate(segments_test_input, 22), 0);
+	CU_ASSERT_EQUAL(segments_test_check(2, 22), 0);
+
+	// A mark that does not agree with what precedes it is data
+	segments_test_interrupt("", 0, 21, 2);
+	file = fopen(segments_test_output, "r");
+	CU_ASSERT_FALSE(segments_present(file));
+	fclose(file);
+	CU_ASSERT_EQUAL(truncate(segments_test_output, size), 0);
+
+	segments_test_teardown();
+}
+
+void test_segments_interrupted_stream(void)
+{
+	CU_ASSERT_EQUAL_FATAL(segments_test_setup(), 0);
+
+	segments_test_grow("abracadabra", 11);
+	FILE *input = fopen(segments_test_input, "r");
+	FILE *output = fopen(segments_test_output, "w");
+	codec_t codec;
+	codec_create(&codec);
+	CU_ASSERT_EQUAL(compress_stream(input, output,
+					COMPRESSION_LEVEL_NORMAL,
+					TRANSFORM_NONE, &codec), 0);
+	codec_destroy(&codec);
+	fclose(input);
+	fclose(output);
+
+	struct stat info;
+	CU_ASSERT_EQUAL_FATAL(stat(segments_test_output, &info), 0);
+	off_t size = info.st_size;
+
+	// The first append to a single stream, stopped after its trailer
+	segments_test_interrupt("\0\0\0\0\0\0\0\0HUFS", 12, 11, 1);
+	CU_ASSERT_EQUAL(segments_test_check(1, 11), 0);
+
+	segments_test_grow("0123456789", 10);
+	long unsigned int appended = 0;
+	CU_ASSERT_EQUAL(segments_append(segments_test_input,
+					segments_test_output,
+					COMPRESSION_LEVEL_NORMAL,
+					TRANSFORM_NONE, &appended), 0);
+	CU_ASSERT_EQUAL(appended, 10);
+	CU_ASSERT_EQUAL(segments_test_check(2, 21), 0);
+
+	// The stream is left in place, followed by its own trailer
+	CU_ASSERT_EQUAL_FATAL(stat(segments_test_output, &info), 0);
+	FILE *file = fopen(segments_test_output, "r");
+	segments_t segments;
+	CU_ASSERT_EQUAL_FATAL(segments_open(&segments, file), 0);
+	CU_ASSERT_EQUAL(segments.segments[0].offset, 0);
+	CU_ASSERT_EQUAL(segments.segments[1].offset,
+			size + SEGMENTS_TRAILER_SIZE);
+	CU_ASSERT_EQUAL(segments.end, info.st_size);
+	segments_close(&segments);
+	fclose(file);
+
+	segments_test_teardown();
+}
+
+void test_segments_growth(void)
+{
+	CU_ASSERT_EQUAL_FATAL(segments_test_setup(), 0);
+
+	// A log, then many short lines appended one at a time
+	size_t length = 0;
+	char line[64];
+	for (int i = 0; length < 100000; i++) {
+		int count = snprintf(line, sizeof(line),
+				     "%05d request served in %d ms\n", i,
+				     i % 97);
+		segments_test_grow(line, count);
+		length += count;
+	}
+
+	long unsigned int appended = 0;
+	CU_ASSERT_EQUAL(segments_append(segments_test_input,
+					segments_test_output,
+					COMPRESSION_LEVEL_NORMAL,
+					TRANSFORM_AUTO, &appended), 0);
+
+	struct stat info;
+	CU_ASSERT_EQUAL_FATAL(stat(segments_test_output, &info), 0);
+	off_t size = info.st_size;
+
+	for (int i = 0; i < 200; i++) {
+		int count = snprintf(line, sizeof(line),
+				     "%05d request served in %d ms\n", i,
+				     i % 97);
+		segments_test_grow(line, count);
+		length += count;
+		CU_ASSERT_EQUAL(segments_append(segments_test_input,
+						segments_test_output,
+						COMPRESSION_LEVEL_NORMAL,
+						TRANSFORM_AUTO, &appended), 0);
+
+		// Each append adds its segment and trailer, whatever the
+		// count: a header with a table of at most `count` symbols,
+		// codes of at most a byte each, and possibly filters
+		CU_ASSERT_EQUAL_FATAL(stat(segments_test_output, &info), 0);
+		off_t bound = HUFFMAN_MAGIC_SIZE + HUFFMAN_FILE_LENGTH_SIZE +
+		    1 + sizeof(long unsigned int) + HUFFMAN_SYMBOL_COUNT_SIZE +
+		    count * (HUFFMAN_SYMBOL_SIZE + HUFFMAN_FREQUENCY_SIZE + 1) +
+		    SEGMENTS_TRAILER_SIZE;
+		CU_ASSERT(info.st_size - size <= bound);
+		size = info.st_size;
+	}
+	CU_ASSERT_EQUAL(segments_test_check(201, length), 0);
+
+	segments_test_teardown();
+}
+
+void test_segments_sampled(void)
+{
+	CU_ASSERT_EQUAL_FATAL(segments_test_setup(), 0);
+
+	// Sampled counts only bound the size of the segment: the space past
+	// it is cut off
+	size_t length = HISTOGRAM_SAMPLE_THRESHOLD;
+	char *data = malloc(length);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(data);
+	unsigned int state = 11;
+	for (size_t i = 0; i < length; i++) {
+		state = state * 1103515245 + 12345;
+		data[i] = 'a' + (state >> 16) % ((state >> 8) % 16 + 1);
+	}
+	segments_test_grow(data, length);
+	free(data);
+
+	long unsigned int appended = 0;
+	CU_ASSERT_EQUAL(segments_append(segments_test_input,
+					segments_test_output,
+					COMPRESSION_LEVEL_FAST,
+					TRANSFORM_NONE, &appended), 0);
+	CU_ASSERT_EQUAL(appended, length);
+	CU_ASSERT_EQUAL(segments_test_check(1, length), 0);
+
+	FILE *file = fopen(segments_test_output, "r");
+	CU_ASSERT(segments_present(file));
+	fclose(file);
+
+	segments_test_teardown();
+}
+
+void test_segments_errors(void)
+{
+	CU_ASSERT_EQUAL_FATAL(segments_test_setup(), 0);
+
+	long unsigned int appended = 0;
+	CU_ASSERT_EQUAL(segments_append("/nonexistent", segments_test_output,
+					COMPRESSION_LEVEL_NORMAL,
+					TRANSFORM_AUTO, &appended), -1);
+
+	segments_test_grow("0123456789", 10);
+	CU_ASSERT_EQUAL(segments_append(segments_test_input,
+					segments_test_output,
+					COMPRESSION_LEVEL_NORMAL,
+					TRANSFORM_AUTO, &appended), 0);
+
+	// Trailers that do not add up to the covered length are refused
+	segments_test_grow("abcde", 5);
+	CU_ASSERT_EQUAL(segments_append(segments_test_input,
+					segments_test_output,
+					COMPRESSION_LEVEL_NORMAL,
+					TRANSFORM_AUTO, &appended), 0);
+	FILE *file = fopen(segments_test_output, "r+");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(file);
+	long unsigned int length = 9;
+	fseek(file, -(long)SEGMENTS_TRAILER_SIZE + sizeof(long unsigned int),
+	      SEEK_END);
+	fwrite(&length, sizeof(length), 1, file);
+	fflush(file);
+
+	segments_t segments;
+	CU_ASSERT(segments_present(file));
+	CU_ASSERT_EQUAL(segments_open(&segments, file), -1);
+	fclose(file);
+
+	// An input shorter than what was covered was not appended to
+	CU_ASSERT_EQUAL(truncate(segments_test_input, 4), 0);
+	CU_ASSERT_EQUAL(segments_append(segments_test_input,
+					segments_test_output,
+					COMPRESSION_LEVEL_NORMAL,
+					TRANSFORM_AUTO, &appended), -1);
+	CU_ASSERT_EQUAL(appended, 0);
+
+	// A single stream that happens to end with the magic is not taken
+	// for a trailer
+	file = fopen(segments_test_output, "w+");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(file);
+	FILE *input = fopen(segments_test_input, "r");
+	codec_t codec;
+	codec_create(&codec);
+	CU_ASSERT_EQUAL(compress_stream(input, file, COMPRESSION_LEVEL_NORMAL,
+					TRANSFORM_NONE, &codec), 0);
+	codec_destroy(&codec);
+	fclose(input);
+	fwrite(SEGMENTS_MAGIC, 1, SEGMENTS_MAGIC_SIZE, file);
+	fflush(file);
+	CU_ASSERT_FALSE(segments_present(file));
+	CU_ASSERT_EQUAL(segments_open(&segments, file), 0);
+	CU_ASSERT_EQUAL(segments.count, 1);
+	CU_ASSERT_EQUAL(segments.length, 4);
+	segments_close(&segments);
+	fclose(file);
+
+	segments_test_teardown();
+}
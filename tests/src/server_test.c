@@ -0,0 +1,303 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "huffman/memory.h"
+#include "huffman/server.h"
+#include "server_test.h"
+
+static server_t server_test_instance;
+static pthread_t server_test_thread;
+
+static void *server_test_run(void *argument)
+{
+	server_run(argument);
+	return NULL;
+}
+
+static int server_test_start(char *path, size_t size)
+{
+	snprintf(path, size, "/tmp/huffman_server_test_%ld.sock",
+		 (long)getpid());
+
+	if (0 != server_create(&server_test_instance, path, 2))
+		return -1;
+
+	return pthread_create(&server_test_thread, NULL, server_test_run,
+			      &server_test_instance);
+}
+
+static void server_test_stop(void)
+{
+	server_stop(&server_test_instance);
+	pthread_join(server_test_thread, NULL);
+	server_destroy(&server_test_instance);
+}
+
+void test_server_roundtrip(void)
+{
+	char path[64];
+	CU_ASSERT_EQUAL(server_test_start(path, sizeof(path)), 0);
+
+	int fd = client_connect(path);
+	CU_ASSERT(fd >= 0);
+
+	size_t length = 100000;
+	unsigned char *payload = malloc(length);
+	for (size_t i = 0; i < length; i++) {
+		payload[i] = "abracadabra"[i % 11] + (i % 97 == 0);
+	}
+
+	unsigned char *compressed = NULL, *decompressed = NULL;
+	size_t compressed_length = 0, decompressed_length = 0;
+
+	// Twice on the same connection: the second run reuses the buffers
+	for (int i = 0; i < 2; i++) {
+		CU_ASSERT_EQUAL(client_request(fd, SERVER_COMPRESS, payload,
+					       length, &compressed,
+					       &compressed_length), SERVER_OK);
+		CU_ASSERT(compressed_length < length);
+		CU_ASSERT_NSTRING_EQUAL((char *)compressed, HUFFMAN_MAGIC,
+					HUFFMAN_MAGIC_SIZE);
+
+		CU_ASSERT_EQUAL(client_request(fd, SERVER_DECOMPRESS,
+					       compressed, compressed_length,
+					       &decompressed,
+					       &decompressed_length),
+				SERVER_OK);
+		CU_ASSERT_EQUAL(decompressed_length, length);
+		CU_ASSERT_EQUAL(memcmp(decompressed, payload, length), 0);
+	}
+
+	// The worker that decoded the payload kept its table
+	bool kept = false;
+	for (int i = 0; i < server_test_instance.worker_count; i++) {
+		kept |= server_test_instance.workers[i].decoder.ready;
+	}
+	CU_ASSERT(kept);
+
+	// Empty payloads round-trip too
+	CU_ASSERT_EQUAL(client_request(fd, SERVER_COMPRESS, payload, 0,
+				       &compressed, &compressed_length),
+			SERVER_OK);
+	CU_ASSERT_EQUAL(compressed_length,
+			HUFFMAN_MAGIC_SIZE + HUFFMAN_FILE_LENGTH_SIZE);
+	CU_ASSERT_EQUAL(client_request(fd, SERVER_DECOMPRESS, compressed,
+				       compressed_length, &decompressed,
+				       &decompressed_length), SERVER_OK);
+	CU_ASSERT_EQUAL(decompressed_length, 0);
+
+	close(fd);
+	free(payload);
+	free(compressed);
+	free(decompressed);
+
+	server_test_stop();
+}
+
+void test_server_errors(void)
+{
+	char path[64];
+	CU_ASSERT_EQUAL(server_test_start(path, sizeof(path)), 0);
+
+	int fd = client_connect(path);
+	CU_ASSERT(fd >= 0);
+
+	unsigned char *response = NULL;
+	size_t response_length = 0;
+	const unsigned char garbage[] = "not a huffman stream";
+
+	CU_ASSERT_EQUAL(client_request(fd, SERVER_DECOMPRESS, garbage,
+				       sizeof(garbage), &response,
+				       &response_length), SERVER_ERROR_PAYLOAD);
+	CU_ASSERT_EQUAL(response_length, 0);
+
+	CU_ASSERT_EQUAL(client_request(fd, 42, garbage, sizeof(garbage),
+				       &response, &response_length),
+			SERVER_ERROR_OPERATION);
+
+	// The connection is still usable after an error
+	CU_ASSERT_EQUAL(client_request(fd, SERVER_COMPRESS, garbage,
+				       sizeof(garbage), &response,
+				       &response_length), SERVER_OK);
+
+	close(fd);
+	free(response);
+
+	server_test_stop();
+}
+
+void test_server_stats(void)
+{
+	char path[64];
+	CU_ASSERT_EQUAL(server_test_start(path, sizeof(path)), 0);
+
+	int fd = client_connect(path);
+	CU_ASSERT(fd >= 0);
+
+	unsigned char *response = NULL;
+	size_t response_length = 0;
+	const unsigned char payload[] = "hello, world";
+
+	for (int i = 0; i < 10; i++) {
+		client_request(fd, SERVER_COMPRESS, payload, sizeof(payload),
+			       &response, &response_length);
+	}
+
+	CU_ASSERT_EQUAL(client_request(fd, SERVER_STATS, NULL, 0, &response,
+				       &response_length), SERVER_OK);
+	CU_ASSERT_NSTRING_EQUAL((char *)response, "requests 10\n", 12);
+
+	server_latency_t latency;
+	server_latency(&server_test_instance, &latency);
+	// The stats request itself is recorded after its response is sent
+	CU_ASSERT(latency.count >= 10);
+	CU_ASSERT(latency.p50 > 0);
+	CU_ASSERT(latency.p50 <= latency.p99);
+	CU_ASSERT(latency.p99 <= latency.max);
+
+	close(fd);
+	free(response);
+
+	server_test_stop();
+}
+
+void test_server_memory_limit(void)
+{
+	memory_configure(MEMORY_BASELINE + 512 * 1024, 2);
+
+	char path[64];
+	CU_ASSERT_EQUAL(server_test_start(path, sizeof(path)), 0);
+
+	int fd = client_connect(path);
+	CU_ASSERT(fd >= 0);
+
+	size_t length = 1024 * 1024;
+	unsigned char *payload = calloc(length, 1);
+	unsigned char *response = NULL;
+	size_t response_length = 0;
+
+	// Too large for the budget: refused, and the connection survives
+	CU_ASSERT_EQUAL(client_request(fd, SERVER_COMPRESS, payload, length,
+				       &response, &response_length),
+			SERVER_ERROR_MEMORY);
+	CU_ASSERT_EQUAL(client_request(fd, SERVER_COMPRESS, payload, 4096,
+				       &response, &response_length),
+			SERVER_OK);
+
+	close(fd);
+	free(payload);
+	free(response);
+
+	server_test_stop();
+	memory_configure(0, 1);
+}
+
+void test_server_max_payload(void)
+{
+	char path[64];
+	CU_ASSERT_EQUAL(server_test_start(path, sizeof(path)), 0);
+
+	// Without a limit, the two workers share half of the memory
+	size_t physical = memory_physical();
+	uint64_t payload = __server_max_payload(&server_test_instance);
+	CU_ASSERT(payload > 0);
+	if (physical > 0)
+		CU_ASSERT(payload <= physical / 8);
+
+	// A limit takes over
+	memory_configure(MEMORY_BASELINE + 512 * 1024, 2);
+	CU_ASSERT(__server_max_payload(&server_test_instance) < 512 * 1024);
+	memory_configure(0, 1);
+
+	server_test_stop();
+}
+
+void test_server_connections(void)
+{
+	char path[64];
+	CU_ASSERT_EQUAL(server_test_start(path, sizeof(path)), 0);
+
+	// More idle connections than workers: none of them holds a worker
+	int idle[4];
+	for (int i = 0; i < 4; i++) {
+		idle[i] = client_connect(path);
+		CU_ASSERT(idle[i] >= 0);
+	}
+
+	int fd = client_connect(path);
+	CU_ASSERT(fd >= 0);
+
+	unsigned char *response = NULL;
+	size_t response_length = 0;
+	const unsigned char payload[] = "hello, world";
+
+	for (int i = 0; i < 3; i++) {
+		CU_ASSERT_EQUAL(client_request(fd, SERVER_COMPRESS, payload,
+					       sizeof(payload), &response,
+					       &response_length), SERVER_OK);
+	}
+	CU_ASSERT_EQUAL(client_request(idle[0], SERVER_COMPRESS, payload,
+				       sizeof(payload), &response,
+				       &response_length), SERVER_OK);
+
+	// Closed connections are reclaimed
+	close(idle[1]);
+	CU_ASSERT_EQUAL(client_request(fd, SERVER_COMPRESS, payload,
+				       sizeof(payload), &response,
+				       &response_length), SERVER_OK);
+
+	// Stopping does not wait for the idle connections
+	server_test_stop();
+
+	close(fd);
+	close(idle[0]);
+	close(idle[2]);
+	close(idle[3]);
+	free(response);
+}
+
+void test_server_path(void)
+{
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/huffman_server_test_%ld.txt",
+		 (long)getpid());
+
+	FILE *file = fopen(path, "w");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(file);
+	fputs("not a socket", file);
+	fclose(file);
+
+	// Only a stale socket is replaced
+	server_t server;
+	CU_ASSERT_EQUAL(server_create(&server, path, 1), -1);
+
+	char buffer[16] = { 0 };
+	file = fopen(path, "r");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(file);
+	CU_ASSERT_PTR_NOT_NULL(fgets(buffer, sizeof(buffer), file));
+	fclose(file);
+	CU_ASSERT_STRING_EQUAL(buffer, "not a socket");
+	unlink(path);
+
+	// A socket left behind by a previous server is
+	struct sockaddr_un address = {.sun_family = AF_UNIX };
+	strcpy(address.sun_path, path);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	CU_ASSERT_EQUAL(bind(fd, (struct sockaddr *)&address,
+			     sizeof(address)), 0);
+	close(fd);
+
+	CU_ASSERT_EQUAL(server_create(&server, path, 1), 0);
+	server_destroy(&server);
+	CU_ASSERT_NOT_EQUAL(access(path, F_OK), 0);
+}
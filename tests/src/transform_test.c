@@ -0,0 +1,198 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "huffman/codec.h"
+#include "huffman/output.h"
+#include "huffman/transform.h"
+#include "transform_test.h"
+
+void test_transform_parse(void)
+{
+	unsigned char filters = 0;
+	char names[32];
+
+	CU_ASSERT_EQUAL(transform_parse("auto", &filters), 0);
+	CU_ASSERT_EQUAL(filters, TRANSFORM_AUTO);
+	CU_ASSERT_EQUAL(transform_parse("none", &filters), 0);
+	CU_ASSERT_EQUAL(filters, TRANSFORM_NONE);
+	CU_ASSERT_EQUAL(transform_parse("rle,delta", &filters), 0);
+	CU_ASSERT_EQUAL(filters, TRANSFORM_DELTA | TRANSFORM_RLE);
+	CU_ASSERT_EQUAL(transform_parse("mtf", &filters), 0);
+	CU_ASSERT_EQUAL(filters, TRANSFORM_MTF);
+	CU_ASSERT_EQUAL(transform_parse("rle,bwt", &filters), -1);
+	CU_ASSERT_EQUAL(transform_parse("rl", &filters), -1);
+
+	transform_names(TRANSFORM_ALL, names, sizeof(names));
+	CU_ASSERT_STRING_EQUAL(names, "delta,mtf,rle");
+	transform_names(TRANSFORM_NONE, names, sizeof(names));
+	CU_ASSERT_STRING_EQUAL(names, "none");
+}
+
+void test_transform_rle(void)
+{
+	const unsigned char input[] = "abbbbbcdd";
+	// Two copies of a run, then the number of further repetitions
+	const unsigned char expected[] = { 'a', 'b', 'b', 3, 'c', 'd', 'd', 0 };
+	unsigned char output[32];
+
+	transform_t transform;
+	transform_create(&transform, TRANSFORM_RLE);
+	size_t length = transform_forward(&transform, input, 4, output);
+	length += transform_forward(&transform, input + 4, 5, output + length);
+	length += transform_flush(&transform, output + length);
+
+	CU_ASSERT_EQUAL(length, sizeof(expected));
+	CU_ASSERT_EQUAL(memcmp(output, expected, sizeof(expected)), 0);
+
+	// Long runs are split at the largest count
+	unsigned char run[600];
+	memset(run, 'x', sizeof(run));
+	transform_create(&transform, TRANSFORM_RLE);
+	length = transform_forward(&transform, run, sizeof(run), output);
+	length += transform_flush(&transform, output + length);
+	CU_ASSERT_EQUAL(length, 9);
+	CU_ASSERT_EQUAL(output[2], TRANSFORM_RLE_MAX);
+	CU_ASSERT_EQUAL(output[5], TRANSFORM_RLE_MAX);
+	CU_ASSERT_EQUAL(output[8], 600 - 2 * (TRANSFORM_RLE_MAX + 2) - 2);
+}
+
+void __transform_fill(unsigned char *data, size_t length)
+{
+	unsigned int state = 12345;
+	for (size_t i = 0; i < length;) {
+		state = state * 1103515245 + 12345;
+		size_t run = 1 + (state >> 16) % 300;
+		unsigned char byte = state >> 8;
+		for (size_t j = 0; j < run && i < length; j++, i++) {
+			// Alternate runs and ramps
+			data[i] = (state & 0x10000000) ? byte : byte + j;
+		}
+	}
+}
+
+void test_transform_roundtrip(void)
+{
+	size_t length = 200000;
+	unsigned char *data = malloc(length);
+	unsigned char *decoded = malloc(length);
+	__transform_fill(data, length);
+
+	for (int filters = 0; filters <= TRANSFORM_ALL; filters++) {
+		FILE *file = tmpfile();
+		fwrite(data, 1, length, file);
+		// Bytes past the given length are never read
+		fwrite(data, 1, 1234, file);
+		rewind(file);
+
+		// Small blocks, so that runs straddle them
+		transform_reader_t reader;
+		CU_ASSERT_EQUAL_FATAL(transform_reader_create
+				      (&reader, file, length, filters, 1000), 0);
+		output_t output;
+		output_open_buffer(&output, decoded, length);
+		transform_t transform;
+		transform_create(&transform, filters);
+
+		const unsigned char *block;
+		size_t count;
+		while ((count = transform_reader_read(&reader, &block)) > 0) {
+			for (size_t i = 0; i < count; i++) {
+				transform_inverse_put(&transform, &output,
+						      block[i]);
+			}
+		}
+
+		CU_ASSERT_EQUAL(output.position, length);
+		CU_ASSERT_EQUAL(memcmp(data, decoded, length), 0);
+
+		transform_reader_destroy(&reader);
+		fclose(file);
+	}
+
+	free(data);
+	free(decoded);
+}
+
+void test_transform_select(void)
+{
+	size_t length = 100000;
+	unsigned char *data = malloc(length);
+
+	// Long runs
+	for (size_t i = 0; i < length; i++) {
+		data[i] = 'a' + (i / 1000) % 4;
+	}
+	FILE *file = tmpfile();
+	fwrite(data, 1, length, file);
+	CU_ASSERT_NOT_EQUAL(transform_select(file, 0, length), TRANSFORM_NONE);
+	CU_ASSERT_EQUAL(ftell(file), 0);
+	fclose(file);
+
+	// Noise gains nothing from any filter
+	unsigned int state = 1;
+	for (size_t i = 0; i < length; i++) {
+		state = state * 1103515245 + 12345;
+		data[i] = state >> 16;
+	}
+	file = tmpfile();
+	fwrite(data, 1, length, file);
+	CU_ASSERT_EQUAL(transform_select(file, 0, length), TRANSFORM_NONE);
+	fclose(file);
+
+	CU_ASSERT_EQUAL(transform_select(NULL, 0, 0), TRANSFORM_NONE);
+
+	free(data);
+}
+
+void test_transform_compress_stream(void)
+{
+	size_t length = 100000;
+	unsigned char *data = malloc(length);
+	unsigned char *decoded = malloc(length);
+	__transform_fill(data, length);
+
+	FILE *input = tmpfile();
+	fwrite(data, 1, length, input);
+	FILE *compressed = tmpfile();
+
+	codec_t codec;
+	codec_create(&codec);
+	CU_ASSERT_EQUAL(compress_stream(input, compressed,
+					COMPRESSION_LEVEL_NORMAL,
+					TRANSFORM_DELTA | TRANSFORM_RLE,
+					&codec), 0);
+	codec_destroy(&codec);
+
+	rewind(compressed);
+	char magic[HUFFMAN_MAGIC_SIZE];
+	CU_ASSERT_EQUAL(fread(magic, 1, HUFFMAN_MAGIC_SIZE, compressed),
+			HUFFMAN_MAGIC_SIZE);
+	CU_ASSERT_EQUAL(memcmp(magic, HUFFMAN_TRANSFORM_MAGIC,
+			       HUFFMAN_MAGIC_SIZE), 0);
+
+	rewind(compressed);
+	stream_header_t header;
+	frequency_table_t frequency_table = NULL;
+	CU_ASSERT_EQUAL_FATAL(read_compressed_file
+			      (compressed, &header, &frequency_table), 0);
+	CU_ASSERT_EQUAL(header.file_length, length);
+	CU_ASSERT_EQUAL(header.filters, TRANSFORM_DELTA | TRANSFORM_RLE);
+	CU_ASSERT(header.symbol_length < length);
+
+	codec_create(&codec);
+	codec_prepare(&codec, frequency_table);
+	output_t output;
+	output_open_buffer(&output, decoded, length);
+	CU_ASSERT_EQUAL(write_file(compressed, &output, &header, &codec), 0);
+	CU_ASSERT_EQUAL(memcmp(data, decoded, length), 0);
+	codec_destroy(&codec);
+
+	frequencies_destroy(&frequency_table);
+	fclose(input);
+	fclose(compressed);
+	free(data);
+	free(decoded);
+}